@@ -0,0 +1,98 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "alloc-cache.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include <unistd.h>
+
+static const char ALLOC_MAGIC[4] = {'S', 'B', 'A', 'C'};
+static const uint32_t ALLOC_VERSION = 1;
+
+AllocKey::AllocKey() : m_hash(14695981039346656037ULL)
+{
+}
+
+void AllocKey::Add(const void* data, size_t size)
+{
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; i++)
+  {
+    m_hash ^= bytes[i];
+    m_hash *= 1099511628211ULL;
+  }
+}
+
+std::string AllocKey::ToHex() const
+{
+  char buf[17];
+  snprintf(buf, sizeof(buf), "%016llx", (unsigned long long) m_hash);
+  return buf;
+}
+
+static std::string
+AllocFileName(const std::string& dir, const AllocKey& key)
+{
+  return dir + "/" + key.ToHex() + ".alloc";
+}
+
+bool LoadAllocation(const std::string& dir, const AllocKey& key, uint32_t nDevices,
+                    std::vector<AllocEntry>& entries)
+{
+  FILE* file = fopen(AllocFileName(dir, key).c_str(), "rb");
+  if (!file)
+  {
+    return false;
+  }
+
+  char magic[4];
+  uint32_t version = 0;
+  uint64_t storedKey = 0;
+  uint32_t count = 0;
+  bool ok = fread(magic, sizeof(magic), 1, file) == 1 &&
+            fread(&version, sizeof(version), 1, file) == 1 &&
+            fread(&storedKey, sizeof(storedKey), 1, file) == 1 &&
+            fread(&count, sizeof(count), 1, file) == 1 &&
+            memcmp(magic, ALLOC_MAGIC, sizeof(magic)) == 0 && version == ALLOC_VERSION &&
+            storedKey == key.Get() && count == nDevices;
+
+  if (ok)
+  {
+    entries.resize(count);
+    ok = fread(entries.data(), sizeof(AllocEntry), count, file) == count;
+  }
+  fclose(file);
+  return ok;
+}
+
+bool SaveAllocation(const std::string& dir, const AllocKey& key,
+                    const std::vector<AllocEntry>& entries)
+{
+  std::string fileName = AllocFileName(dir, key);
+  std::string tmpName = fileName + "." + std::to_string(getpid());
+
+  FILE* file = fopen(tmpName.c_str(), "wb");
+  if (!file)
+  {
+    return false;
+  }
+
+  uint64_t storedKey = key.Get();
+  uint32_t count = (uint32_t) entries.size();
+  bool ok = fwrite(ALLOC_MAGIC, sizeof(ALLOC_MAGIC), 1, file) == 1 &&
+            fwrite(&ALLOC_VERSION, sizeof(ALLOC_VERSION), 1, file) == 1 &&
+            fwrite(&storedKey, sizeof(storedKey), 1, file) == 1 &&
+            fwrite(&count, sizeof(count), 1, file) == 1 &&
+            fwrite(entries.data(), sizeof(AllocEntry), count, file) == count;
+  ok = fclose(file) == 0 && ok;
+
+  if (!ok || rename(tmpName.c_str(), fileName.c_str()) != 0)
+  {
+    unlink(tmpName.c_str());
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,84 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+/*
+ * On-disk cache of the SF/TP allocations.
+ *
+ * An allocation is fully determined by the coordinates, the gateway set,
+ * the scheme, its parameters and the seed, so its result (data rate and
+ * transmission power of every end device) is stored in a small binary file
+ * named after a 64-bit FNV-1a hash of all of these. A later run of the same
+ * scenario, in this or another process, reloads it instead of running the
+ * allocator again.
+ *
+ * File layout (host byte order): "SBAC", uint32 version (1), uint64 key,
+ * uint32 device count, then one AllocEntry per device.
+ */
+
+#ifndef ALLOC_CACHE_H
+#define ALLOC_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Incremental FNV-1a hash of the inputs of an allocation.
+ */
+class AllocKey
+{
+public:
+  AllocKey();
+
+  void Add(const void* data, size_t size);
+
+  template <class T>
+  void Add(const T& value)
+  {
+    Add(&value, sizeof(value));
+  }
+
+  void Add(const std::string& value)
+  {
+    Add(value.data(), value.size());
+  }
+
+  uint64_t Get() const
+  {
+    return m_hash;
+  }
+
+  /**
+   * \return The key as 16 hexadecimal digits, used as the file name.
+   */
+  std::string ToHex() const;
+
+private:
+  uint64_t m_hash;
+};
+
+struct AllocEntry
+{
+  uint8_t m_dataRate;
+  uint8_t m_txPower; //!< dBm
+};
+
+/**
+ * Load the allocation of key from dir.
+ *
+ * \return false if there is no valid entry for key with nDevices devices.
+ */
+bool LoadAllocation(const std::string& dir, const AllocKey& key, uint32_t nDevices,
+                    std::vector<AllocEntry>& entries);
+
+/**
+ * Store the allocation of key in dir. The file is written under a
+ * temporary name and renamed, so concurrent runs never read a partial entry.
+ *
+ * \return false if the file could not be written.
+ */
+bool SaveAllocation(const std::string& dir, const AllocKey& key,
+                    const std::vector<AllocEntry>& entries);
+
+#endif /* ALLOC_CACHE_H */
@@ -0,0 +1,178 @@
+import argparse
+import itertools
+import json
+import os
+import re
+import sys
+import time
+import numpy as np
+import pandas as pd
+
+from sbrc26 import ns3_cmd, script, make_file_name
+
+# Columns of the perf table written by sbrc26.cc with --perfReport
+perf_names = ['devices', 'gateways', 'setup', 'alloc', 'install', 'run', 'report',
+              'events', 'events_per_s', 'peak_rss_kb', 'nRun']
+
+# Fixed presets: repo layouts x allocation x confirmation mode x simulated hours
+preset_devices = [200, 600, 1000]
+preset_gateways = [1, 8, 28]
+preset_sfas = ['isfa', 'rsfa', 'drsftpa']
+preset_tx_modes = ['nack', 'ack']
+preset_hours = [1, 24]
+preset_metrics = ['wall_s', 'setup', 'alloc', 'install', 'run', 'report', 'events', 'events_per_s', 'peak_rss_kb']
+# Metrics that fail the comparison; the short setup/report phases are left out as too noisy
+preset_gated = ['wall_s', 'alloc', 'install', 'run', 'events_per_s', 'peak_rss_kb']
+# Metrics for which a higher value is better, the others regress upwards
+preset_higher_better = {'events_per_s'}
+
+def gen_layout(path, n_devices, n_gateways, axis, seed=42):
+    """Random SM coordinates and a regular gateway grid on an axis x axis area,
+    for sizes beyond the 1000 SMs shipped with the repo."""
+    rng = np.random.default_rng(seed)
+    sm_file = make_file_name(path, f'{n_devices}sm_file')
+    pd.DataFrame(rng.uniform(0, axis, (n_devices, 2))).to_csv(sm_file, header=False, index=False)
+
+    side = int(np.ceil(np.sqrt(n_gateways)))
+    cells = (np.arange(side) + 0.5) * axis / side
+    grid = np.array([(x, y) for x in cells for y in cells])[:n_gateways]
+    gw_file = make_file_name(path, f'{n_gateways}gw_file')
+    pd.DataFrame(grid).to_csv(gw_file, header=False, index=False)
+    return sm_file, gw_file
+
+def bench(sizes, path, sim_time, sfa, meters_per_gw, axis, extra=''):
+    os.system(ns3_cmd)
+
+    rows = []
+    for n in sizes:
+        # Keep the device density per gateway constant while scaling up
+        n_gateways = max(1, int(round(n / meters_per_gw)))
+        run_path = f'{path}/{n}'
+        os.makedirs(run_path, exist_ok=True)
+        sm_file, gw_file = gen_layout(run_path, n, n_gateways, axis * np.sqrt(n / 1000))
+
+        perf_file = make_file_name(run_path, f'{n_gateways}gw_perf')
+        if os.path.exists(perf_file):
+            os.remove(perf_file)
+
+        params = (f'--nDevices={n} --nGateways={n_gateways} --smFile={sm_file} --gwFile={gw_file} '
+                  f'--sfa={sfa} --simulationTime={sim_time} --path={run_path} --perfReport=1 {extra}')
+        exit_code = os.system(f'{ns3_cmd} run "{script} {params}"')
+        if exit_code != 0 or not os.path.exists(perf_file):
+            print(f'[ERRO] {n} dispositivos | Código: {exit_code}')
+            continue
+
+        rows.append(pd.read_csv(perf_file, names=perf_names).iloc[-1])
+
+    df = pd.DataFrame(rows)
+    if not df.empty:
+        df['peak_rss_mb'] = df['peak_rss_kb'] / 1024
+        cols = ['devices', 'gateways', 'setup', 'alloc', 'install', 'run', 'events_per_s', 'peak_rss_mb']
+        print(df[cols].to_string(index=False))
+        df.to_csv(f'{path}/bench.csv', index=False)
+    return df
+
+def presets(pattern=''):
+    """Names and parameters of the fixed presets whose name matches pattern."""
+    for n, k, sfa, tx_mode, hours in itertools.product(preset_devices, preset_gateways, preset_sfas,
+                                                       preset_tx_modes, preset_hours):
+        name = f'{n}sm_{k}gw_{sfa}_{tx_mode}_{hours}h'
+        if re.search(pattern, name):
+            yield name, dict(devices=n, gateways=k, sfa=sfa, tx_mode=tx_mode, hours=hours)
+
+def run_preset(name, preset, path, coords_dir, extra=''):
+    """Run one preset (seed 1) and return its perf row plus the wall time of the process."""
+    run_path = f'{path}/{name}'
+    os.makedirs(run_path, exist_ok=True)
+    n, k = preset['devices'], preset['gateways']
+    perf_file = make_file_name(run_path, f'{k}gw_perf')
+    if os.path.exists(perf_file):
+        os.remove(perf_file)
+
+    params = (f'--nDevices={n} --nGateways={k} --smFile={coords_dir}/{n}/{n}sms.csv '
+              f'--gwFile={coords_dir}/{n}/{k}gws.csv --radius=7000 --sfa={preset["sfa"]} '
+              f'--txMode={preset["tx_mode"]} --simulationTime={preset["hours"] * 3600} '
+              f'--path={run_path} --nRun=1 --perfReport=1 {extra}')
+    start = time.time()
+    exit_code = os.system(f'{ns3_cmd} run "{script} {params}"')
+    wall = time.time() - start
+    if exit_code != 0 or not os.path.exists(perf_file):
+        print(f'[ERRO] {name} | Código: {exit_code}')
+        return None
+
+    row = pd.read_csv(perf_file, names=perf_names).iloc[-1]
+    result = {m: float(row[m]) for m in preset_metrics if m != 'wall_s'}
+    result['wall_s'] = wall
+    return result
+
+def compare(results, baseline, tolerance):
+    """Print the change of every metric against the baseline and return the
+    presets/metrics that got worse by more than tolerance (fraction)."""
+    regressions = []
+    for name, result in results.items():
+        if name not in baseline:
+            print(f'{name}: no baseline')
+            continue
+        changes = []
+        for m in preset_metrics:
+            old = baseline[name].get(m)
+            if not old:
+                continue
+            change = result[m] / old - 1
+            worse = -change if m in preset_higher_better else change
+            if worse > tolerance and m in preset_gated:
+                regressions.append((name, m, change))
+            changes.append(f'{m} {change:+.1%}')
+        print(f'{name}: ' + ', '.join(changes))
+    return regressions
+
+def bench_presets(path, coords_dir, pattern='', baseline=None, save_baseline=None, tolerance=0.1, extra=''):
+    os.system(ns3_cmd)
+
+    results = {}
+    for name, preset in presets(pattern):
+        result = run_preset(name, preset, path, coords_dir, extra)
+        if result is not None:
+            results[name] = dict(preset, **result)
+
+    with open(f'{path}/presets.json', 'w') as f:
+        json.dump(results, f, indent=1, sort_keys=True)
+    if save_baseline:
+        with open(save_baseline, 'w') as f:
+            json.dump(results, f, indent=1, sort_keys=True)
+
+    if baseline:
+        with open(baseline) as f:
+            regressions = compare(results, json.load(f), tolerance)
+        for name, m, change in regressions:
+            print(f'[REGRESSÃO] {name} {m} {change:+.1%}')
+        return not regressions
+    return True
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Setup time, event rate and peak RSS of sbrc26.cc per device count')
+    parser.add_argument('--sizes', default='1000,5000,10000,50000')
+    parser.add_argument('--path', default='bench')
+    parser.add_argument('--sim-time', type=float, default=3600, help='Simulated time (s) of each run')
+    parser.add_argument('--sfa', default='isfa')
+    parser.add_argument('--meters-per-gw', type=int, default=100)
+    parser.add_argument('--axis', type=float, default=7000, help='Side (m) of the 1000-SM area, scaled with sqrt(N)')
+    parser.add_argument('--extra', default='', help='Extra sbrc26.cc arguments')
+    parser.add_argument('--presets', default=None, metavar='REGEX',
+                        help="Run the fixed presets matching REGEX ('' for all, e.g. '_1h$') instead of --sizes")
+    parser.add_argument('--coords-dir', default=os.path.dirname(os.path.abspath(__file__)),
+                        help='Directory with the <N>/<N>sms.csv and <N>/<k>gws.csv layouts of the presets')
+    parser.add_argument('--baseline', default=None, help='Preset results JSON to compare against')
+    parser.add_argument('--save-baseline', default=None, help='Also write the preset results to this JSON')
+    parser.add_argument('--tolerance', type=float, default=0.1, help='Relative change counted as a regression')
+    args = parser.parse_args()
+
+    if args.presets is not None:
+        path = os.path.abspath(args.path)
+        os.makedirs(path, exist_ok=True)
+        ok = bench_presets(path, os.path.abspath(args.coords_dir), args.presets, args.baseline,
+                           args.save_baseline, args.tolerance, args.extra)
+        sys.exit(0 if ok else 1)
+
+    bench([int(n) for n in args.sizes.split(',')], os.path.abspath(args.path), args.sim_time,
+          args.sfa, args.meters_per_gw, args.axis, args.extra)
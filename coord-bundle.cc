@@ -0,0 +1,273 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "coord-bundle.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <tuple>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char BUNDLE_MAGIC[4] = {'S', 'B', 'C', 'B'};
+static const uint32_t BUNDLE_VERSION = 1;
+
+/**
+ * Read the first two columns of a headerless CSV file.
+ */
+static bool
+ReadCsvPoints(const std::string& fileName, std::vector<double>& xy)
+{
+  std::ifstream in(fileName);
+  if (!in)
+  {
+    return false;
+  }
+
+  std::string line;
+  while (std::getline(in, line))
+  {
+    const char* p = line.c_str();
+    char* end;
+    double x = strtod(p, &end);
+    if (end == p || *end != ',')
+    {
+      continue; // Blank or malformed row
+    }
+    p = end + 1;
+    double y = strtod(p, &end);
+    if (end == p)
+    {
+      continue;
+    }
+    xy.push_back(x);
+    xy.push_back(y);
+  }
+  return true;
+}
+
+/**
+ * \return true if name is made of digits only.
+ */
+static bool
+IsNumber(const std::string& name)
+{
+  return !name.empty() && std::all_of(name.begin(), name.end(), ::isdigit);
+}
+
+bool BuildCoordBundle(const std::string& coordsDir, const std::string& bundleFile,
+                      std::string& error)
+{
+  std::vector<CoordSetEntry> entries;
+  std::vector<std::vector<double>> sets;
+
+  std::error_code ec;
+  for (const auto& dir : std::filesystem::directory_iterator(coordsDir, ec))
+  {
+    std::string name = dir.path().filename().string();
+    if (!dir.is_directory() || !IsNumber(name))
+    {
+      continue;
+    }
+    uint32_t density = (uint32_t) std::stoul(name);
+
+    for (const auto& file : std::filesystem::directory_iterator(dir.path()))
+    {
+      std::string fileName = file.path().filename().string();
+      CoordSetEntry entry = {};
+      entry.m_density = density;
+
+      if (fileName == name + "sms.csv")
+      {
+        entry.m_kind = COORDS_SM;
+        entry.m_k = density;
+      }
+      else if (fileName.size() > 7 && fileName.compare(fileName.size() - 7, 7, "gws.csv") == 0 &&
+               IsNumber(fileName.substr(0, fileName.size() - 7)))
+      {
+        entry.m_kind = COORDS_GW;
+        entry.m_k = (uint32_t) std::stoul(fileName.substr(0, fileName.size() - 7));
+      }
+      else
+      {
+        continue;
+      }
+
+      std::vector<double> xy;
+      if (!ReadCsvPoints(file.path().string(), xy))
+      {
+        error = "cannot read " + file.path().string();
+        return false;
+      }
+      entry.m_nPoints = (uint32_t) (xy.size() / 2);
+      entries.push_back(entry);
+      sets.push_back(std::move(xy));
+    }
+  }
+  if (ec)
+  {
+    error = "cannot list " + coordsDir + ": " + ec.message();
+    return false;
+  }
+
+  // Directory order is unspecified, sort so that the same tree always gives
+  // the same bundle
+  std::vector<size_t> order(entries.size());
+  for (size_t i = 0; i < order.size(); i++)
+  {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [&entries](size_t a, size_t b) {
+    return std::make_tuple(entries[a].m_kind, entries[a].m_density, entries[a].m_k) <
+           std::make_tuple(entries[b].m_kind, entries[b].m_density, entries[b].m_k);
+  });
+
+  std::vector<CoordSetEntry> sortedEntries;
+  std::vector<std::vector<double>> sortedSets;
+  for (size_t i : order)
+  {
+    sortedEntries.push_back(entries[i]);
+    sortedSets.push_back(std::move(sets[i]));
+  }
+  entries.swap(sortedEntries);
+  sets.swap(sortedSets);
+
+  CoordBundleHeader header = {};
+  memcpy(header.m_magic, BUNDLE_MAGIC, sizeof(BUNDLE_MAGIC));
+  header.m_version = BUNDLE_VERSION;
+  header.m_nSets = (uint32_t) entries.size();
+
+  uint64_t offset = sizeof(header) + entries.size() * sizeof(CoordSetEntry);
+  for (size_t i = 0; i < entries.size(); i++)
+  {
+    entries[i].m_offset = offset;
+    offset += sets[i].size() * sizeof(double);
+  }
+
+  std::string tmpName = bundleFile + "." + std::to_string(getpid());
+  FILE* out = fopen(tmpName.c_str(), "wb");
+  if (!out)
+  {
+    error = "cannot write " + tmpName + ": " + strerror(errno);
+    return false;
+  }
+
+  bool ok = fwrite(&header, sizeof(header), 1, out) == 1 &&
+            fwrite(entries.data(), sizeof(CoordSetEntry), entries.size(), out) == entries.size();
+  for (size_t i = 0; ok && i < sets.size(); i++)
+  {
+    ok = fwrite(sets[i].data(), sizeof(double), sets[i].size(), out) == sets[i].size();
+  }
+  ok = fclose(out) == 0 && ok;
+
+  if (!ok || rename(tmpName.c_str(), bundleFile.c_str()) != 0)
+  {
+    unlink(tmpName.c_str());
+    error = "cannot write " + bundleFile;
+    return false;
+  }
+  return true;
+}
+
+CoordBundle::CoordBundle() : m_base(nullptr), m_size(0), m_entries(nullptr), m_nSets(0)
+{
+}
+
+CoordBundle::~CoordBundle()
+{
+  Close();
+}
+
+bool CoordBundle::Open(const std::string& bundleFile, std::string& error)
+{
+  Close();
+
+  int fd = open(bundleFile.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    error = "cannot open " + bundleFile + ": " + strerror(errno);
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(CoordBundleHeader))
+  {
+    close(fd);
+    error = bundleFile + " is too short";
+    return false;
+  }
+
+  void* base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+  {
+    error = "cannot map " + bundleFile + ": " + strerror(errno);
+    return false;
+  }
+
+  m_base = static_cast<const char*>(base);
+  m_size = st.st_size;
+
+  const CoordBundleHeader* header = reinterpret_cast<const CoordBundleHeader*>(m_base);
+  if (memcmp(header->m_magic, BUNDLE_MAGIC, sizeof(BUNDLE_MAGIC)) != 0 ||
+      header->m_version != BUNDLE_VERSION ||
+      sizeof(*header) + (size_t) header->m_nSets * sizeof(CoordSetEntry) > m_size)
+  {
+    Close();
+    error = bundleFile + " is not a coordinate bundle";
+    return false;
+  }
+
+  m_nSets = header->m_nSets;
+  m_entries = reinterpret_cast<const CoordSetEntry*>(m_base + sizeof(*header));
+  for (uint32_t i = 0; i < m_nSets; i++)
+  {
+    if (m_entries[i].m_offset + (uint64_t) m_entries[i].m_nPoints * 2 * sizeof(double) > m_size)
+    {
+      Close();
+      error = bundleFile + " is truncated";
+      return false;
+    }
+  }
+  return true;
+}
+
+const double* CoordBundle::Find(CoordSetKind kind, uint32_t density, uint32_t k,
+                                uint32_t& nPoints) const
+{
+  for (uint32_t i = 0; i < m_nSets; i++)
+  {
+    const CoordSetEntry& entry = m_entries[i];
+    if (entry.m_kind == (uint32_t) kind && entry.m_density == density &&
+        (kind == COORDS_SM || entry.m_k == k))
+    {
+      nPoints = entry.m_nPoints;
+      return reinterpret_cast<const double*>(m_base + entry.m_offset);
+    }
+  }
+  nPoints = 0;
+  return nullptr;
+}
+
+void CoordBundle::Close()
+{
+  if (m_base)
+  {
+    munmap(const_cast<char*>(m_base), m_size);
+  }
+  m_base = nullptr;
+  m_size = 0;
+  m_entries = nullptr;
+  m_nSets = 0;
+}
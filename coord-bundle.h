@@ -0,0 +1,98 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+/*
+ * Binary bundle of all the coordinate sets of the repo.
+ *
+ * One file holds every <N>/<N>sms.csv smart-meter set and every
+ * <N>/<k>gws.csv k-means gateway set, already parsed. It is memory mapped
+ * read-only, so the sets are shared by the runs of a process and by the
+ * workers forked from it, and positioning the nodes needs no text parsing.
+ *
+ * File layout (host byte order):
+ *   CoordBundleHeader, CoordSetEntry[m_nSets], then the x, y doubles of
+ *   every set at the offset given by its entry.
+ */
+
+#ifndef COORD_BUNDLE_H
+#define COORD_BUNDLE_H
+
+#include <cstdint>
+#include <string>
+
+enum CoordSetKind
+{
+  COORDS_SM = 0, //!< Smart meters of a density, <N>/<N>sms.csv
+  COORDS_GW = 1  //!< Gateway layout with k gateways, <N>/<k>gws.csv
+};
+
+struct CoordBundleHeader
+{
+  char m_magic[4];    //!< "SBCB"
+  uint32_t m_version; //!< Format version, currently 1
+  uint32_t m_nSets;   //!< Number of CoordSetEntry that follow
+  uint32_t m_pad;
+};
+
+struct CoordSetEntry
+{
+  uint32_t m_kind;    //!< CoordSetKind
+  uint32_t m_density; //!< N of the directory the set comes from
+  uint32_t m_k;       //!< Gateway count for COORDS_GW, N for COORDS_SM
+  uint32_t m_nPoints; //!< Number of (x, y) pairs
+  uint64_t m_offset;  //!< Byte offset of the first x from the start of the file
+};
+
+/**
+ * Build a bundle from every numeric <N> directory under coordsDir.
+ *
+ * \return false, with an explanation in error, if a file cannot be read or
+ *         the bundle cannot be written.
+ */
+bool BuildCoordBundle(const std::string& coordsDir, const std::string& bundleFile,
+                      std::string& error);
+
+class CoordBundle
+{
+public:
+  CoordBundle();
+  ~CoordBundle();
+
+  CoordBundle(const CoordBundle&) = delete;
+  CoordBundle& operator=(const CoordBundle&) = delete;
+
+  /**
+   * Map bundleFile, replacing any bundle opened before.
+   *
+   * \return false, with an explanation in error, if it is not a valid bundle.
+   */
+  bool Open(const std::string& bundleFile, std::string& error);
+
+  bool IsOpen() const
+  {
+    return m_base != nullptr;
+  }
+
+  /**
+   * Look up a set.
+   *
+   * \param kind COORDS_SM or COORDS_GW.
+   * \param density N of the scenario.
+   * \param k Gateway count, ignored for COORDS_SM.
+   * \param nPoints Number of points of the set.
+   * \return The interleaved x, y coordinates, or nullptr if the set is not
+   *         in the bundle.
+   */
+  const double* Find(CoordSetKind kind, uint32_t density, uint32_t k, uint32_t& nPoints) const;
+
+  void Close();
+
+private:
+  const char* m_base;
+  size_t m_size;
+  const CoordSetEntry* m_entries;
+  uint32_t m_nSets;
+};
+
+#endif /* COORD_BUNDLE_H */
@@ -0,0 +1,56 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "counting-scheduler.h"
+
+namespace ns3
+{
+
+NS_OBJECT_ENSURE_REGISTERED(CountingMapScheduler);
+
+uint64_t CountingMapScheduler::s_depth = 0;
+uint64_t CountingMapScheduler::s_maxDepth = 0;
+
+TypeId CountingMapScheduler::GetTypeId()
+{
+  static TypeId tid = TypeId("ns3::CountingMapScheduler")
+                          .SetParent<MapScheduler>()
+                          .SetGroupName("Core")
+                          .AddConstructor<CountingMapScheduler>();
+  return tid;
+}
+
+CountingMapScheduler::CountingMapScheduler()
+{
+  // A new scheduler is filled by Insert from the one it replaces
+  s_depth = 0;
+  s_maxDepth = 0;
+}
+
+CountingMapScheduler::~CountingMapScheduler()
+{
+}
+
+void CountingMapScheduler::Insert(const Event& ev)
+{
+  MapScheduler::Insert(ev);
+  if (++s_depth > s_maxDepth)
+  {
+    s_maxDepth = s_depth;
+  }
+}
+
+Scheduler::Event CountingMapScheduler::RemoveNext()
+{
+  s_depth--;
+  return MapScheduler::RemoveNext();
+}
+
+void CountingMapScheduler::Remove(const Event& ev)
+{
+  s_depth--;
+  MapScheduler::Remove(ev);
+}
+
+} // namespace ns3
@@ -0,0 +1,62 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+/*
+ * MapScheduler that counts its pending events.
+ *
+ * The simulator exposes the number of executed events but not the size of
+ * its event queue. This scheduler is the default std::map scheduler plus a
+ * counter updated by Insert and the two Remove calls, so the queue depth can
+ * be sampled while the run profile is on. The counter is process-wide: there
+ * is one simulator per process, sweep workers included.
+ */
+
+#ifndef COUNTING_SCHEDULER_H
+#define COUNTING_SCHEDULER_H
+
+#include "ns3/map-scheduler.h"
+
+#include <cstdint>
+
+namespace ns3
+{
+
+class CountingMapScheduler : public MapScheduler
+{
+public:
+  static TypeId GetTypeId();
+
+  CountingMapScheduler();
+  ~CountingMapScheduler() override;
+
+  void Insert(const Event& ev) override;
+  Event RemoveNext() override;
+  void Remove(const Event& ev) override;
+
+  static uint64_t GetDepth()
+  {
+    return s_depth;
+  }
+
+  /**
+   * \return The largest depth since the last ResetMaxDepth.
+   */
+  static uint64_t GetMaxDepth()
+  {
+    return s_maxDepth;
+  }
+
+  static void ResetMaxDepth()
+  {
+    s_maxDepth = s_depth;
+  }
+
+private:
+  static uint64_t s_depth;
+  static uint64_t s_maxDepth;
+};
+
+} // namespace ns3
+
+#endif /* COUNTING_SCHEDULER_H */
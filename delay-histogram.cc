@@ -0,0 +1,57 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "delay-histogram.h"
+
+#include <cmath>
+
+DelayHistogram::DelayHistogram()
+{
+  Clear();
+}
+
+double DelayHistogram::Value(uint32_t index)
+{
+  if (index < LINEAR)
+  {
+    return index;
+  }
+
+  uint32_t msb = (index - LINEAR) / SUB_BUCKETS + 7;
+  uint32_t sub = (index - LINEAR) % SUB_BUCKETS + SUB_BUCKETS;
+  uint32_t shift = msb - 6;
+  double low = std::ldexp((double) sub, (int) shift);
+  return low + std::ldexp(0.5, (int) shift);
+}
+
+double DelayHistogram::Quantile(double q) const
+{
+  if (m_total == 0)
+  {
+    return 0.0;
+  }
+
+  uint64_t rank = (uint64_t) std::ceil(q * m_total);
+  if (rank == 0)
+  {
+    rank = 1;
+  }
+
+  uint64_t seen = 0;
+  for (uint32_t i = 0; i < N_BUCKETS; i++)
+  {
+    seen += m_counts[i];
+    if (seen >= rank)
+    {
+      return Value(i) / 1000;
+    }
+  }
+  return Value(N_BUCKETS - 1) / 1000;
+}
+
+void DelayHistogram::Clear()
+{
+  m_counts.fill(0);
+  m_total = 0;
+}
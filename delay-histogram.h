@@ -0,0 +1,81 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+/*
+ * Constant-memory log-bucketed delay histogram (HDR style).
+ *
+ * Delays are recorded in whole microseconds. Values below 128 us get one
+ * bucket each; above that, every power of two is split into 64 linear
+ * sub-buckets, so a bucket is never wider than 1/64 (1.6%) of the values it
+ * holds. The bucket array is fixed at compile time and covers delays up to
+ * 2^40 us (about 12 days), larger values saturate in the last bucket.
+ */
+
+#ifndef DELAY_HISTOGRAM_H
+#define DELAY_HISTOGRAM_H
+
+#include <array>
+#include <cstdint>
+
+class DelayHistogram
+{
+public:
+  static const uint32_t LINEAR = 128;   //!< Values with a bucket of their own
+  static const uint32_t SUB_BUCKETS = 64; //!< Sub-buckets per power of two
+  static const uint32_t MAX_BITS = 40;  //!< Values saturate at 2^MAX_BITS - 1 us
+  static const uint32_t N_BUCKETS = LINEAR + (MAX_BITS - 7) * SUB_BUCKETS;
+
+  DelayHistogram();
+
+  /**
+   * \param delayMs Delay in milliseconds, negative values count as 0.
+   */
+  void Record(double delayMs)
+  {
+    uint64_t us = delayMs > 0 ? (uint64_t) (delayMs * 1000) : 0;
+    m_counts[Index(us)]++;
+    m_total++;
+  }
+
+  uint64_t GetCount() const
+  {
+    return m_total;
+  }
+
+  /**
+   * \param q Quantile in [0, 1], e.g. 0.999.
+   * \return The delay (ms) below which a fraction q of the recorded values
+   *         lie, at bucket resolution, or 0 if nothing was recorded.
+   */
+  double Quantile(double q) const;
+
+  void Clear();
+
+private:
+  static uint32_t Index(uint64_t us)
+  {
+    if (us < LINEAR)
+    {
+      return (uint32_t) us;
+    }
+
+    uint32_t msb = 63 - __builtin_clzll(us);
+    if (msb >= MAX_BITS)
+    {
+      return N_BUCKETS - 1;
+    }
+    uint32_t shift = msb - 6;
+    return LINEAR + (msb - 7) * SUB_BUCKETS + (uint32_t) ((us >> shift) - SUB_BUCKETS);
+  }
+
+  /**
+   * \return The middle of bucket index, in microseconds.
+   */
+  static double Value(uint32_t index);
+
+  std::array<uint64_t, N_BUCKETS> m_counts;
+  uint64_t m_total;
+};
+
+#endif /* DELAY_HISTOGRAM_H */
@@ -0,0 +1,52 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "device-registry.h"
+
+#include "ns3/lora-net-device.h"
+
+using namespace ns3;
+using namespace lorawan;
+
+void DeviceRegistry::AddEndDevices(const NodeContainer& endDevices)
+{
+  m_endDevices.reserve(m_endDevices.size() + endDevices.GetN());
+  for (uint32_t i = 0; i < endDevices.GetN(); i++)
+  {
+    Ptr<LoraNetDevice> dev = DynamicCast<LoraNetDevice>(endDevices.Get(i)->GetDevice(0));
+
+    EndDeviceHandles handles;
+    handles.m_mac = PeekPointer(DynamicCast<EndDeviceLorawanMac>(dev->GetMac()));
+    handles.m_phy = PeekPointer(DynamicCast<EndDeviceLoraPhy>(dev->GetPhy()));
+    m_endDevices.push_back(handles);
+  }
+}
+
+void DeviceRegistry::AddGateways(const NodeContainer& gateways)
+{
+  m_gateways.reserve(m_gateways.size() + gateways.GetN());
+  for (uint32_t i = 0; i < gateways.GetN(); i++)
+  {
+    Ptr<LoraNetDevice> dev = DynamicCast<LoraNetDevice>(gateways.Get(i)->GetDevice(0));
+
+    GatewayHandles handles;
+    handles.m_mac = PeekPointer(DynamicCast<GatewayLorawanMac>(dev->GetMac()));
+    handles.m_phy = PeekPointer(DynamicCast<GatewayLoraPhy>(dev->GetPhy()));
+    m_gateways.push_back(handles);
+  }
+}
+
+void DeviceRegistry::SetEnergyModels(const energy::DeviceEnergyModelContainer& models)
+{
+  for (uint32_t i = 0; i < models.GetN() && i < m_endDevices.size(); i++)
+  {
+    m_endDevices[i].m_energy = PeekPointer(models.Get(i));
+  }
+}
+
+void DeviceRegistry::Clear()
+{
+  m_endDevices.clear();
+  m_gateways.clear();
+}
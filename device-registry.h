@@ -0,0 +1,91 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+/*
+ * Per-run table of the MAC, PHY and energy model of every node.
+ *
+ * Resolving a MAC from a node goes through GetDevice, a DynamicCast and a
+ * GetObject walk over the aggregate array. The registry does it once per
+ * node after the devices are installed and keeps plain pointers indexed by
+ * end device and gateway index, so the trace callbacks and the reports pay
+ * one array access instead. The pointers do not own the objects: the nodes
+ * keep them alive until Simulator::Destroy, and the registry must be
+ * cleared together with the other per-run state.
+ */
+
+#ifndef DEVICE_REGISTRY_H
+#define DEVICE_REGISTRY_H
+
+#include "ns3/device-energy-model-container.h"
+#include "ns3/end-device-lora-phy.h"
+#include "ns3/end-device-lorawan-mac.h"
+#include "ns3/gateway-lora-phy.h"
+#include "ns3/gateway-lorawan-mac.h"
+#include "ns3/node-container.h"
+
+#include <cstdint>
+#include <vector>
+
+struct EndDeviceHandles
+{
+  ns3::lorawan::EndDeviceLorawanMac* m_mac = nullptr;
+  ns3::lorawan::EndDeviceLoraPhy* m_phy = nullptr;
+  ns3::energy::DeviceEnergyModel* m_energy = nullptr; //!< Set by SetEnergyModels
+};
+
+struct GatewayHandles
+{
+  ns3::lorawan::GatewayLorawanMac* m_mac = nullptr;
+  ns3::lorawan::GatewayLoraPhy* m_phy = nullptr;
+};
+
+class DeviceRegistry
+{
+public:
+  /**
+   * Register the end devices, in container order, after their LoraNetDevice
+   * has been installed.
+   */
+  void AddEndDevices(const ns3::NodeContainer& endDevices);
+
+  /**
+   * Register the gateways, in container order, after their LoraNetDevice
+   * has been installed.
+   */
+  void AddGateways(const ns3::NodeContainer& gateways);
+
+  /**
+   * Attach the radio energy models returned by LoraRadioEnergyModelHelper,
+   * which are in the order of the end device net devices.
+   */
+  void SetEnergyModels(const ns3::energy::DeviceEnergyModelContainer& models);
+
+  const EndDeviceHandles& GetEndDevice(uint32_t edId) const
+  {
+    return m_endDevices[edId];
+  }
+
+  const GatewayHandles& GetGateway(uint32_t gwId) const
+  {
+    return m_gateways[gwId];
+  }
+
+  uint32_t GetNEndDevices() const
+  {
+    return (uint32_t) m_endDevices.size();
+  }
+
+  uint32_t GetNGateways() const
+  {
+    return (uint32_t) m_gateways.size();
+  }
+
+  void Clear();
+
+private:
+  std::vector<EndDeviceHandles> m_endDevices;
+  std::vector<GatewayHandles> m_gateways;
+};
+
+#endif /* DEVICE_REGISTRY_H */
@@ -0,0 +1,49 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "event-profiler.h"
+
+#include <cmath>
+
+void EventProfiler::Setup(const std::vector<std::string>& names)
+{
+  Clear();
+  m_probes.resize(names.size());
+  for (size_t i = 0; i < names.size(); i++)
+  {
+    m_probes[i].m_name = names[i];
+  }
+}
+
+double EventProfiler::Quantile(uint32_t probe, double q) const
+{
+  const Probe& p = m_probes[probe];
+  if (p.m_count == 0)
+  {
+    return 0.0;
+  }
+
+  uint64_t rank = (uint64_t) std::ceil(q * p.m_count);
+  if (rank == 0)
+  {
+    rank = 1;
+  }
+
+  uint64_t seen = 0;
+  for (uint32_t b = 0; b < N_BINS; b++)
+  {
+    seen += p.m_bins[b];
+    if (seen >= rank)
+    {
+      return std::ldexp(1.0, (int) b + 1);
+    }
+  }
+  return std::ldexp(1.0, N_BINS);
+}
+
+void EventProfiler::Clear()
+{
+  m_probes.clear();
+  m_hours.clear();
+}
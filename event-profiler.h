@@ -0,0 +1,165 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+/*
+ * Opt-in cost profile of the trace callbacks and of the simulated hours.
+ *
+ * Every probe (one per callback type) keeps a call count, the cumulative
+ * cost and a log2 histogram of the cost of one call, in TSC cycles where
+ * the CPU has a time stamp counter and in nanoseconds otherwise. Quantiles
+ * are read from the histogram, at power-of-two resolution. A ProfileScope
+ * placed at the top of a callback times it; when the profiler is not set up
+ * the scope costs one branch. The hour samples hold the simulator events
+ * executed, the wall time and the scheduler queue depth of each simulated
+ * hour.
+ */
+
+#ifndef EVENT_PROFILER_H
+#define EVENT_PROFILER_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+struct HourSample
+{
+  uint32_t m_hour;          //!< Simulated hour, from 1
+  uint64_t m_events;        //!< Simulator events executed during the hour
+  double m_wallSeconds;     //!< Wall time spent simulating the hour
+  uint64_t m_queueDepth;    //!< Pending events at the end of the hour
+  uint64_t m_maxQueueDepth; //!< Largest number of pending events during the hour
+};
+
+class EventProfiler
+{
+public:
+  static const uint32_t N_BINS = 64; //!< Bin b holds costs in [2^b, 2^(b+1))
+
+  /**
+   * Enable the profiler with one probe per name, discarding the previous
+   * profile. Probe ids are the indices in names.
+   */
+  void Setup(const std::vector<std::string>& names);
+
+  bool IsEnabled() const
+  {
+    return !m_probes.empty();
+  }
+
+  /**
+   * \return A monotonic time stamp, in the unit of the probe costs.
+   */
+  static uint64_t Now()
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+  }
+
+  static const char* Unit()
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    return "cycles";
+#else
+    return "ns";
+#endif
+  }
+
+  void Record(uint32_t probe, uint64_t cost)
+  {
+    Probe& p = m_probes[probe];
+    p.m_count++;
+    p.m_cost += cost;
+    p.m_bins[cost > 0 ? 63 - __builtin_clzll(cost) : 0]++;
+  }
+
+  uint32_t GetNProbes() const
+  {
+    return (uint32_t) m_probes.size();
+  }
+
+  const std::string& GetName(uint32_t probe) const
+  {
+    return m_probes[probe].m_name;
+  }
+
+  uint64_t GetCount(uint32_t probe) const
+  {
+    return m_probes[probe].m_count;
+  }
+
+  uint64_t GetCost(uint32_t probe) const
+  {
+    return m_probes[probe].m_cost;
+  }
+
+  /**
+   * \return The upper bound of the bin holding the q quantile of the cost
+   *         of one call, or 0 if the probe never fired.
+   */
+  double Quantile(uint32_t probe, double q) const;
+
+  void AddHour(const HourSample& sample)
+  {
+    m_hours.push_back(sample);
+  }
+
+  const std::vector<HourSample>& GetHours() const
+  {
+    return m_hours;
+  }
+
+  void Clear();
+
+private:
+  struct Probe
+  {
+    std::string m_name;
+    uint64_t m_count = 0;
+    uint64_t m_cost = 0;
+    std::array<uint64_t, N_BINS> m_bins{};
+  };
+
+  std::vector<Probe> m_probes;
+  std::vector<HourSample> m_hours;
+};
+
+/**
+ * Times the enclosing block into one probe of the profiler.
+ */
+class ProfileScope
+{
+public:
+  ProfileScope(EventProfiler& profiler, uint32_t probe)
+      : m_profiler(profiler.IsEnabled() ? &profiler : nullptr),
+        m_probe(probe),
+        m_start(m_profiler ? EventProfiler::Now() : 0)
+  {
+  }
+
+  ~ProfileScope()
+  {
+    if (m_profiler)
+    {
+      m_profiler->Record(m_probe, EventProfiler::Now() - m_start);
+    }
+  }
+
+private:
+  EventProfiler* m_profiler;
+  uint32_t m_probe;
+  uint64_t m_start;
+};
+
+#endif /* EVENT_PROFILER_H */
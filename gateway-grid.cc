@@ -0,0 +1,102 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "gateway-grid.h"
+
+#include <algorithm>
+#include <cmath>
+
+GatewayGrid::GatewayGrid()
+    : m_minX(0),
+      m_minY(0),
+      m_cellSize(1),
+      m_nx(0),
+      m_ny(0)
+{
+}
+
+int32_t GatewayGrid::CellX(double x) const
+{
+  return std::clamp((int32_t) std::floor((x - m_minX) / m_cellSize), 0, m_nx - 1);
+}
+
+int32_t GatewayGrid::CellY(double y) const
+{
+  return std::clamp((int32_t) std::floor((y - m_minY) / m_cellSize), 0, m_ny - 1);
+}
+
+void GatewayGrid::Build(const std::vector<double>& x, const std::vector<double>& y, double cellSize)
+{
+  m_x = x;
+  m_y = y;
+  m_cellStart.clear();
+  m_ids.clear();
+  if (x.empty())
+  {
+    return;
+  }
+
+  m_minX = *std::min_element(x.begin(), x.end());
+  m_minY = *std::min_element(y.begin(), y.end());
+  double maxX = *std::max_element(x.begin(), x.end());
+  double maxY = *std::max_element(y.begin(), y.end());
+
+  // Bounded cell count, whatever the spread of the gateways
+  m_cellSize = std::max(cellSize, std::max(maxX - m_minX, maxY - m_minY) / 1024);
+  m_cellSize = std::max(m_cellSize, 1.0);
+  m_nx = (int32_t) ((maxX - m_minX) / m_cellSize) + 1;
+  m_ny = (int32_t) ((maxY - m_minY) / m_cellSize) + 1;
+
+  // Counting sort of the gateways by cell, ids stay increasing within a cell
+  std::vector<uint32_t> cellOf(x.size());
+  m_cellStart.assign((size_t) m_nx * m_ny + 1, 0);
+  for (size_t g = 0; g < x.size(); g++)
+  {
+    cellOf[g] = (uint32_t) (CellY(y[g]) * m_nx + CellX(x[g]));
+    m_cellStart[cellOf[g] + 1]++;
+  }
+  for (size_t c = 1; c < m_cellStart.size(); c++)
+  {
+    m_cellStart[c] += m_cellStart[c - 1];
+  }
+
+  std::vector<uint32_t> next(m_cellStart.begin(), m_cellStart.end() - 1);
+  m_ids.resize(x.size());
+  for (size_t g = 0; g < x.size(); g++)
+  {
+    m_ids[next[cellOf[g]]++] = (uint32_t) g;
+  }
+}
+
+void GatewayGrid::Query(double x, double y, double range, std::vector<uint32_t>& out) const
+{
+  out.clear();
+  if (m_x.empty())
+  {
+    return;
+  }
+
+  double range2 = range * range;
+  int32_t x0 = CellX(x - range);
+  int32_t x1 = CellX(x + range);
+  int32_t y0 = CellY(y - range);
+  int32_t y1 = CellY(y + range);
+  for (int32_t cy = y0; cy <= y1; cy++)
+  {
+    for (int32_t cx = x0; cx <= x1; cx++)
+    {
+      size_t cell = (size_t) cy * m_nx + cx;
+      for (uint32_t i = m_cellStart[cell]; i < m_cellStart[cell + 1]; i++)
+      {
+        double dx = m_x[m_ids[i]] - x;
+        double dy = m_y[m_ids[i]] - y;
+        if (dx * dx + dy * dy <= range2)
+        {
+          out.push_back(m_ids[i]);
+        }
+      }
+    }
+  }
+  std::sort(out.begin(), out.end());
+}
@@ -0,0 +1,59 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+/*
+ * Uniform-grid spatial index over the gateway positions.
+ *
+ * Gateways are bucketed in square cells (compressed row storage: one
+ * offset array, one id array), so the gateways within a radius of a point
+ * are found by scanning the few cells the radius overlaps instead of the
+ * whole gateway list. With a cell as wide as the radius, a query touches at
+ * most 3 x 3 cells. Distances are horizontal; the results are in increasing
+ * gateway id order.
+ */
+
+#ifndef GATEWAY_GRID_H
+#define GATEWAY_GRID_H
+
+#include <cstdint>
+#include <vector>
+
+class GatewayGrid
+{
+public:
+  GatewayGrid();
+
+  /**
+   * Index the gateways at (x[i], y[i]), discarding the previous ones.
+   *
+   * \param cellSize Side of a cell (m), e.g. the query radius.
+   */
+  void Build(const std::vector<double>& x, const std::vector<double>& y, double cellSize);
+
+  bool IsEmpty() const
+  {
+    return m_x.empty();
+  }
+
+  /**
+   * Replace out with the ids of the gateways within range (m) of (x, y).
+   */
+  void Query(double x, double y, double range, std::vector<uint32_t>& out) const;
+
+private:
+  int32_t CellX(double x) const;
+  int32_t CellY(double y) const;
+
+  std::vector<double> m_x;
+  std::vector<double> m_y;
+  double m_minX;
+  double m_minY;
+  double m_cellSize;
+  int32_t m_nx;
+  int32_t m_ny;
+  std::vector<uint32_t> m_cellStart; //!< First entry of each cell in m_ids, plus an end marker
+  std::vector<uint32_t> m_ids;       //!< Gateway ids, grouped by cell
+};
+
+#endif /* GATEWAY_GRID_H */
@@ -0,0 +1,74 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "gateway-search.h"
+
+GatewaySearch::GatewaySearch(uint32_t minGateways, uint32_t maxGateways, bool gallop)
+    : m_min(minGateways),
+      m_max(maxGateways),
+      m_gallop(gallop)
+{
+}
+
+bool GatewaySearch::Test(uint32_t nGateways)
+{
+  auto it = m_probes.find(nGateways);
+  if (it != m_probes.end())
+  {
+    return it->second;
+  }
+
+  bool pass = m_probe(nGateways);
+  m_probes[nGateways] = pass;
+  return pass;
+}
+
+uint32_t GatewaySearch::Run(Probe probe)
+{
+  m_probe = probe;
+  m_probes.clear();
+
+  // Invariant: every count below lo misses, hi meets the target
+  uint32_t lo = m_min;
+  uint32_t hi = m_max;
+
+  if (m_gallop)
+  {
+    uint32_t step = 1;
+    uint32_t k = m_min;
+    while (true)
+    {
+      if (Test(k))
+      {
+        hi = k;
+        break;
+      }
+      lo = k + 1;
+      if (k == m_max)
+      {
+        return 0;
+      }
+      k = m_min + step < m_max ? m_min + step : m_max;
+      step *= 2;
+    }
+  }
+  else if (!Test(m_max))
+  {
+    return 0;
+  }
+
+  while (lo < hi)
+  {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (Test(mid))
+    {
+      hi = mid;
+    }
+    else
+    {
+      lo = mid + 1;
+    }
+  }
+  return hi;
+}
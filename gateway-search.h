@@ -0,0 +1,55 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+/*
+ * Search of the smallest gateway count meeting a PDR target.
+ *
+ * The PDR of a density grows with the number of gateways of its layout, so
+ * "meets the target" is monotone in the gateway count and the threshold can
+ * be found by testing a few counts instead of all of them. Bisection takes
+ * about log2(range) probes; galloping (1, 2, 4, ... gateways above the
+ * lower end, then bisection in the last gap) is cheaper when the threshold
+ * sits near the lower end. Every count is probed at most once.
+ */
+
+#ifndef GATEWAY_SEARCH_H
+#define GATEWAY_SEARCH_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+
+class GatewaySearch
+{
+public:
+  //! Run the scenario with nGateways and return whether it meets the target
+  typedef std::function<bool(uint32_t nGateways)> Probe;
+
+  GatewaySearch(uint32_t minGateways, uint32_t maxGateways, bool gallop);
+
+  /**
+   * \return The smallest gateway count in [minGateways, maxGateways] that
+   *         meets the target, 0 if even maxGateways misses it.
+   */
+  uint32_t Run(Probe probe);
+
+  /**
+   * \return The result of every probed count.
+   */
+  const std::map<uint32_t, bool>& GetProbes() const
+  {
+    return m_probes;
+  }
+
+private:
+  bool Test(uint32_t nGateways);
+
+  uint32_t m_min;
+  uint32_t m_max;
+  bool m_gallop;
+  Probe m_probe;
+  std::map<uint32_t, bool> m_probes;
+};
+
+#endif /* GATEWAY_SEARCH_H */
@@ -0,0 +1,254 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "kmeans.h"
+
+#include <algorithm>
+#include <limits>
+#include <thread>
+
+// Bound to const references by std::min
+const uint32_t KMeans::N_BLOCKS;
+
+KMeans::KMeans(uint64_t seed, uint32_t nThreads)
+    : m_seed(seed),
+      m_rng(seed),
+      m_nThreads(nThreads),
+      m_maxIter(300),
+      m_tol(1e-4)
+{
+  if (m_nThreads == 0)
+  {
+    m_nThreads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  m_nThreads = std::min(m_nThreads, N_BLOCKS);
+}
+
+void KMeans::SetPoints(const std::vector<double>& x, const std::vector<double>& y)
+{
+  if (x == m_x && y == m_y)
+  {
+    return;
+  }
+
+  m_x = x;
+  m_y = y;
+  m_layouts.clear();
+  m_inertia.clear();
+  m_rng.seed(m_seed);
+}
+
+const std::vector<double>& KMeans::GetLayout(uint32_t k)
+{
+  while (m_layouts.size() < k)
+  {
+    std::vector<double> cx;
+    std::vector<double> cy;
+    for (size_t c = 0; c < m_layouts.size(); c++)
+    {
+      cx.push_back(m_layouts.back()[2 * c]);
+      cy.push_back(m_layouts.back()[2 * c + 1]);
+    }
+
+    AddCenter(cx, cy);
+    m_inertia.push_back(Lloyd(cx, cy));
+
+    std::vector<double> layout;
+    for (size_t c = 0; c < cx.size(); c++)
+    {
+      layout.push_back(cx[c]);
+      layout.push_back(cy[c]);
+    }
+    m_layouts.push_back(layout);
+  }
+  return m_layouts[k - 1];
+}
+
+void KMeans::AddCenter(std::vector<double>& cx, std::vector<double>& cy)
+{
+  size_t n = m_x.size();
+  if (cx.empty())
+  {
+    std::uniform_int_distribution<size_t> pick(0, n - 1);
+    size_t i = pick(m_rng);
+    cx.push_back(m_x[i]);
+    cy.push_back(m_y[i]);
+    return;
+  }
+
+  std::vector<double> cumulative(n);
+  double total = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    double best = std::numeric_limits<double>::infinity();
+    for (size_t c = 0; c < cx.size(); c++)
+    {
+      double dx = m_x[i] - cx[c];
+      double dy = m_y[i] - cy[c];
+      best = std::min(best, dx * dx + dy * dy);
+    }
+    total += best;
+    cumulative[i] = total;
+  }
+
+  std::uniform_real_distribution<double> draw(0, total);
+  size_t i = std::upper_bound(cumulative.begin(), cumulative.end(), draw(m_rng)) - cumulative.begin();
+  i = std::min(i, n - 1);
+  cx.push_back(m_x[i]);
+  cy.push_back(m_y[i]);
+}
+
+double KMeans::Assign(const std::vector<double>& cx, const std::vector<double>& cy,
+                      std::vector<double>& sumX, std::vector<double>& sumY,
+                      std::vector<uint64_t>& count, uint32_t& farthest)
+{
+  size_t n = m_x.size();
+  size_t k = cx.size();
+  size_t blockSize = (n + N_BLOCKS - 1) / N_BLOCKS;
+
+  struct Block
+  {
+    std::vector<double> m_sumX;
+    std::vector<double> m_sumY;
+    std::vector<uint64_t> m_count;
+    double m_inertia = 0;
+    double m_farthestDist = -1;
+    uint32_t m_farthest = 0;
+  };
+  std::vector<Block> blocks(N_BLOCKS);
+  uint32_t nThreads = n >= 4 * N_BLOCKS ? m_nThreads : 1;
+
+  auto work = [&](uint32_t first) {
+    for (uint32_t b = first; b < N_BLOCKS; b += nThreads)
+    {
+      Block& block = blocks[b];
+      block.m_sumX.assign(k, 0.0);
+      block.m_sumY.assign(k, 0.0);
+      block.m_count.assign(k, 0);
+
+      size_t end = std::min(n, (b + 1) * blockSize);
+      for (size_t i = b * blockSize; i < end; i++)
+      {
+        double px = m_x[i];
+        double py = m_y[i];
+        double best = std::numeric_limits<double>::infinity();
+        size_t bestC = 0;
+        for (size_t c = 0; c < k; c++)
+        {
+          double dx = px - cx[c];
+          double dy = py - cy[c];
+          double d = dx * dx + dy * dy;
+          bestC = d < best ? c : bestC;
+          best = d < best ? d : best;
+        }
+
+        block.m_sumX[bestC] += px;
+        block.m_sumY[bestC] += py;
+        block.m_count[bestC]++;
+        block.m_inertia += best;
+        if (best > block.m_farthestDist)
+        {
+          block.m_farthestDist = best;
+          block.m_farthest = (uint32_t) i;
+        }
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (uint32_t t = 1; t < nThreads; t++)
+  {
+    threads.emplace_back(work, t);
+  }
+  work(0);
+  for (std::thread& thread : threads)
+  {
+    thread.join();
+  }
+
+  sumX.assign(k, 0.0);
+  sumY.assign(k, 0.0);
+  count.assign(k, 0);
+  double inertia = 0;
+  double farthestDist = -1;
+  for (const Block& block : blocks)
+  {
+    for (size_t c = 0; c < k; c++)
+    {
+      sumX[c] += block.m_sumX[c];
+      sumY[c] += block.m_sumY[c];
+      count[c] += block.m_count[c];
+    }
+    inertia += block.m_inertia;
+    if (block.m_farthestDist > farthestDist)
+    {
+      farthestDist = block.m_farthestDist;
+      farthest = block.m_farthest;
+    }
+  }
+  return inertia;
+}
+
+double KMeans::Lloyd(std::vector<double>& cx, std::vector<double>& cy)
+{
+  size_t n = m_x.size();
+  size_t k = cx.size();
+
+  double meanX = 0;
+  double meanY = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    meanX += m_x[i];
+    meanY += m_y[i];
+  }
+  meanX /= n;
+  meanY /= n;
+  double variance = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    variance += (m_x[i] - meanX) * (m_x[i] - meanX) + (m_y[i] - meanY) * (m_y[i] - meanY);
+  }
+  double tol = m_tol * variance / (2 * n);
+
+  std::vector<double> sumX;
+  std::vector<double> sumY;
+  std::vector<uint64_t> count;
+  uint32_t farthest = 0;
+
+  for (uint32_t iter = 0; iter < m_maxIter; iter++)
+  {
+    Assign(cx, cy, sumX, sumY, count, farthest);
+
+    double shift = 0;
+    bool relocated = false;
+    for (size_t c = 0; c < k; c++)
+    {
+      double nx = cx[c];
+      double ny = cy[c];
+      if (count[c] > 0)
+      {
+        nx = sumX[c] / count[c];
+        ny = sumY[c] / count[c];
+      }
+      else if (!relocated)
+      {
+        // Empty cluster: restart it on the point worst served
+        nx = m_x[farthest];
+        ny = m_y[farthest];
+        relocated = true;
+      }
+      shift += (nx - cx[c]) * (nx - cx[c]) + (ny - cy[c]) * (ny - cy[c]);
+      cx[c] = nx;
+      cy[c] = ny;
+    }
+
+    if (shift <= tol)
+    {
+      break;
+    }
+  }
+
+  // The last move changed the centroids: assign once more for their inertia
+  return Assign(cx, cy, sumX, sumY, count, farthest);
+}
@@ -0,0 +1,97 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+/*
+ * k-means gateway placement over the SM positions, replacing coords.py.
+ *
+ * Points are stored as separate x and y arrays so the distance loop over
+ * the centroids vectorises. The assignment step of each Lloyd iteration
+ * starts threads over a fixed number of point blocks and joins them; the
+ * partial sums are reduced in block order, so a layout is bit-identical
+ * whatever the number of threads. Layouts grow incrementally: the k layout starts
+ * from the k - 1 centroids plus one k-means++ (D^2 sampled) centroid, and
+ * the layouts of one point set are kept, so asking for any k costs at most
+ * the missing steps of the chain. The random generator is seeded once per
+ * point set (42 by default, as in coords.py), which makes every layout a
+ * function of the points and k only. Layouts are not the scikit-learn ones.
+ */
+
+#ifndef KMEANS_H
+#define KMEANS_H
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+class KMeans
+{
+public:
+  static const uint32_t N_BLOCKS = 64; //!< Point blocks of the assignment step
+
+  /**
+   * \param seed Seed of the k-means++ sampling.
+   * \param nThreads Worker threads of the assignment step, 0 for one per core.
+   */
+  explicit KMeans(uint64_t seed = 42, uint32_t nThreads = 0);
+
+  /**
+   * Use a new point set, discarding the layouts of the previous one. Does
+   * nothing if the points are the ones already set.
+   */
+  void SetPoints(const std::vector<double>& x, const std::vector<double>& y);
+
+  uint32_t GetNPoints() const
+  {
+    return (uint32_t) m_x.size();
+  }
+
+  /**
+   * \return The k centroids, as interleaved x, y.
+   */
+  const std::vector<double>& GetLayout(uint32_t k);
+
+  /**
+   * \return The sum of squared distances of the points to their centroid
+   *         in the k layout, computed by GetLayout.
+   */
+  double GetInertia(uint32_t k) const
+  {
+    return m_inertia[k - 1];
+  }
+
+private:
+  /**
+   * Add one centroid drawn with probability proportional to the squared
+   * distance of each point to its closest centroid.
+   */
+  void AddCenter(std::vector<double>& cx, std::vector<double>& cy);
+
+  /**
+   * Lloyd iterations from the centroids cx, cy until they move less than
+   * the tolerance.
+   *
+   * \return The inertia of the final assignment.
+   */
+  double Lloyd(std::vector<double>& cx, std::vector<double>& cy);
+
+  /**
+   * One assignment pass: per centroid point count and coordinate sums, and
+   * the inertia, reduced in block order.
+   */
+  double Assign(const std::vector<double>& cx, const std::vector<double>& cy,
+                std::vector<double>& sumX, std::vector<double>& sumY,
+                std::vector<uint64_t>& count, uint32_t& farthest);
+
+  std::vector<double> m_x;
+  std::vector<double> m_y;
+  std::vector<std::vector<double>> m_layouts; //!< Layout of k at index k - 1
+  std::vector<double> m_inertia;
+  uint64_t m_seed;
+  std::mt19937_64 m_rng;
+  uint32_t m_nThreads;
+  uint32_t m_maxIter;
+  double m_tol; //!< Relative to the mean variance of the coordinates, as in scikit-learn
+};
+
+#endif /* KMEANS_H */
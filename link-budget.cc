@@ -0,0 +1,221 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "link-budget.h"
+
+#include <cmath>
+#include <limits>
+
+LinkBudget::LinkBudget()
+    : m_exponent(3.0),
+      m_referenceDistance(1.0),
+      m_referenceLoss(46.6777),
+      m_dirty(true),
+      m_maxRange(0),
+      m_candidatesDirty(true)
+{
+}
+
+void LinkBudget::SetPathLoss(double exponent, double referenceDistance, double referenceLoss)
+{
+  if (exponent != m_exponent || referenceDistance != m_referenceDistance ||
+      referenceLoss != m_referenceLoss)
+  {
+    m_exponent = exponent;
+    m_referenceDistance = referenceDistance;
+    m_referenceLoss = referenceLoss;
+    m_dirty = true;
+  }
+}
+
+/**
+ * Copy one coordinate of src into dst.
+ *
+ * \return true if dst changed.
+ */
+bool LinkBudget::Assign(std::vector<double>& dst, const std::vector<LinkPosition>& src,
+                        double LinkPosition::*field)
+{
+  bool changed = dst.size() != src.size();
+  dst.resize(src.size());
+  for (size_t i = 0; i < src.size(); i++)
+  {
+    changed = changed || dst[i] != src[i].*field;
+    dst[i] = src[i].*field;
+  }
+  return changed;
+}
+
+void LinkBudget::SetPositions(const std::vector<LinkPosition>& endDevices,
+                              const std::vector<LinkPosition>& gateways)
+{
+  bool changed = Assign(m_edX, endDevices, &LinkPosition::x);
+  changed = Assign(m_edY, endDevices, &LinkPosition::y) || changed;
+  changed = Assign(m_edZ, endDevices, &LinkPosition::z) || changed;
+  changed = Assign(m_gwX, gateways, &LinkPosition::x) || changed;
+  changed = Assign(m_gwY, gateways, &LinkPosition::y) || changed;
+  changed = Assign(m_gwZ, gateways, &LinkPosition::z) || changed;
+  m_dirty = m_dirty || changed;
+  m_candidatesDirty = m_candidatesDirty || changed;
+}
+
+void LinkBudget::SetMaxRange(double range)
+{
+  if (range != m_maxRange)
+  {
+    m_maxRange = range;
+    m_candidatesDirty = true;
+  }
+}
+
+double LinkBudget::GetRange(double txPowerDbm, double sensitivityDbm, double marginDb) const
+{
+  double maxLoss = txPowerDbm - sensitivityDbm + marginDb;
+  return m_referenceDistance * std::pow(10.0, (maxLoss - m_referenceLoss) / (10 * m_exponent));
+}
+
+void LinkBudget::ComputeCandidates()
+{
+  size_t nEds = m_edX.size();
+  m_grid.Build(m_gwX, m_gwY, m_maxRange);
+
+  m_candStart.assign(nEds + 1, 0);
+  m_candidates.clear();
+  std::vector<uint32_t> found;
+  for (size_t e = 0; e < nEds; e++)
+  {
+    m_grid.Query(m_edX[e], m_edY[e], m_maxRange, found);
+    m_candidates.insert(m_candidates.end(), found.begin(), found.end());
+    m_candStart[e + 1] = (uint32_t) m_candidates.size();
+  }
+
+  m_candidatesDirty = false;
+}
+
+void LinkBudget::ComputePathLoss()
+{
+  size_t nEds = m_edX.size();
+  size_t nGws = m_gwX.size();
+  m_pathLoss.resize(nEds * nGws);
+
+  // L = L0 + 10 n log10(d / d0) = L0 + 5 n log10(d^2 / d0^2), below d0 the
+  // loss is clamped to L0 like LogDistancePropagationLossModel does
+  double minD2 = m_referenceDistance * m_referenceDistance;
+  double slope = 5 * m_exponent;
+  for (size_t g = 0; g < nGws; g++)
+  {
+    double gx = m_gwX[g];
+    double gy = m_gwY[g];
+    double gz = m_gwZ[g];
+    double* row = &m_pathLoss[g * nEds];
+
+    // Branch-free over contiguous arrays: vectorised by the compiler
+    for (size_t e = 0; e < nEds; e++)
+    {
+      double dx = m_edX[e] - gx;
+      double dy = m_edY[e] - gy;
+      double dz = m_edZ[e] - gz;
+      double d2 = dx * dx + dy * dy + dz * dz;
+      row[e] = d2 > minD2 ? d2 / minD2 : 1.0;
+    }
+
+    for (size_t e = 0; e < nEds; e++)
+    {
+      row[e] = m_referenceLoss + slope * std::log10(row[e]);
+    }
+  }
+
+  m_dirty = false;
+}
+
+void LinkBudget::Compute(double txPowerDbm, PairGain gain)
+{
+  if (m_dirty)
+  {
+    ComputePathLoss();
+  }
+
+  if (m_maxRange > 0 && m_candidatesDirty)
+  {
+    ComputeCandidates();
+  }
+
+  size_t nEds = m_edX.size();
+  size_t nGws = m_gwX.size();
+  m_rxPower.resize(nEds * nGws);
+  for (size_t i = 0; i < m_rxPower.size(); i++)
+  {
+    m_rxPower[i] = txPowerDbm - m_pathLoss[i];
+  }
+
+  if (gain)
+  {
+    // Device-major, the order in which the allocators of the lorawan module
+    // query the channel, so that lazily drawn random terms come out the same
+    for (size_t e = 0; e < nEds; e++)
+    {
+      uint32_t n;
+      const uint32_t* candidates = GetCandidates((uint32_t) e, n);
+      for (uint32_t i = 0; i < n; i++)
+      {
+        uint32_t g = candidates ? candidates[i] : i;
+        m_rxPower[g * nEds + e] += gain((uint32_t) e, g);
+      }
+    }
+  }
+
+  if (m_maxRange > 0)
+  {
+    ComputeBestCandidates();
+    return;
+  }
+
+  m_bestGw.assign(nEds, 0);
+  m_bestRxPower.assign(m_rxPower.begin(), m_rxPower.begin() + (nGws > 0 ? nEds : 0));
+  m_bestRxPower.resize(nEds, 0.0);
+  for (size_t g = 1; g < nGws; g++)
+  {
+    const double* row = &m_rxPower[g * nEds];
+    for (size_t e = 0; e < nEds; e++)
+    {
+      if (row[e] > m_bestRxPower[e])
+      {
+        m_bestRxPower[e] = row[e];
+        m_bestGw[e] = (uint32_t) g;
+      }
+    }
+  }
+}
+
+void LinkBudget::ComputeBestCandidates()
+{
+  size_t nEds = m_edX.size();
+  size_t nGws = m_gwX.size();
+  m_bestGw.assign(nEds, 0);
+  m_bestRxPower.assign(nEds, 0.0);
+  for (size_t e = 0; e < nEds; e++)
+  {
+    uint32_t n;
+    const uint32_t* candidates = GetCandidates((uint32_t) e, n);
+    if (n == 0)
+    {
+      // Nothing in range: the strongest of all, none of them decodes anyway
+      candidates = nullptr;
+      n = (uint32_t) nGws;
+    }
+
+    double best = -std::numeric_limits<double>::infinity();
+    for (uint32_t i = 0; i < n; i++)
+    {
+      uint32_t g = candidates ? candidates[i] : i;
+      double rxPower = m_rxPower[g * nEds + e];
+      if (rxPower > best)
+      {
+        best = rxPower;
+        m_bestGw[e] = g;
+      }
+    }
+    m_bestRxPower[e] = n > 0 ? best : 0.0;
+  }
+}
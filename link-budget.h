@@ -0,0 +1,149 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+/*
+ * End device x gateway link-budget matrix.
+ *
+ * Positions are kept as a structure of arrays, and the log-distance part of
+ * the path loss is evaluated for all the pairs of a gateway in one
+ * branch-free pass over contiguous arrays, which the compiler vectorises.
+ * It only depends on the positions, so it is kept across the runs of a
+ * process as long as the coordinates do not change. The per-pair terms that
+ * do change with the seed (shadowing) are added on top by the caller, and
+ * the best gateway and receive power of every device are then derived from
+ * the matrix. With a maximum range, a gateway grid gives every device its
+ * candidate gateways: only those pairs get the per-pair term and compete
+ * for the best gateway, the others keep their log-distance power alone.
+ */
+
+#ifndef LINK_BUDGET_H
+#define LINK_BUDGET_H
+
+#include "gateway-grid.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+struct LinkPosition
+{
+  double x;
+  double y;
+  double z;
+};
+
+class LinkBudget
+{
+public:
+  /// Extra gain (dB, negative for a loss) of the pair (end device, gateway)
+  typedef std::function<double(uint32_t, uint32_t)> PairGain;
+
+  LinkBudget();
+
+  /**
+   * Parameters of the log-distance model: L = L0 + 10 n log10(d / d0).
+   */
+  void SetPathLoss(double exponent, double referenceDistance, double referenceLoss);
+
+  /**
+   * Set the end device and gateway positions. The log-distance matrix is
+   * only recomputed by the next Compute if they differ from the current ones.
+   */
+  void SetPositions(const std::vector<LinkPosition>& endDevices,
+                    const std::vector<LinkPosition>& gateways);
+
+  /**
+   * Only gateways within range (m, horizontal) of a device are candidates
+   * for it, 0 (the default) to consider every gateway.
+   */
+  void SetMaxRange(double range);
+
+  /**
+   * \return The distance (m) at which the log-distance receive power of
+   *         txPowerDbm falls to sensitivityDbm - marginDb.
+   */
+  double GetRange(double txPowerDbm, double sensitivityDbm, double marginDb) const;
+
+  /**
+   * Compute the receive power of every pair for txPowerDbm, reusing the
+   * log-distance matrix if neither the positions nor the model changed
+   * since the last call, then add gain of every pair, if set, and update
+   * the best gateway of every device.
+   */
+  void Compute(double txPowerDbm, PairGain gain = PairGain());
+
+  uint32_t GetNEndDevices() const
+  {
+    return (uint32_t) m_edX.size();
+  }
+
+  uint32_t GetNGateways() const
+  {
+    return (uint32_t) m_gwX.size();
+  }
+
+  /**
+   * \return Receive power (dBm) of the pair, gateway-major storage.
+   */
+  double GetRxPower(uint32_t edId, uint32_t gwId) const
+  {
+    return m_rxPower[(size_t) gwId * m_edX.size() + edId];
+  }
+
+  uint32_t GetBestGateway(uint32_t edId) const
+  {
+    return m_bestGw[edId];
+  }
+
+  double GetBestRxPower(uint32_t edId) const
+  {
+    return m_bestRxPower[edId];
+  }
+
+  /**
+   * \param edId End device.
+   * \param n Number of candidate gateways of the device.
+   * \return Its candidate gateways, in increasing id order, or nullptr if
+   *         every gateway is a candidate (no maximum range).
+   */
+  const uint32_t* GetCandidates(uint32_t edId, uint32_t& n) const
+  {
+    if (m_maxRange <= 0)
+    {
+      n = GetNGateways();
+      return nullptr;
+    }
+    n = m_candStart[edId + 1] - m_candStart[edId];
+    return m_candidates.data() + m_candStart[edId];
+  }
+
+private:
+  void ComputePathLoss();
+  void ComputeCandidates();
+  void ComputeBestCandidates();
+
+  static bool Assign(std::vector<double>& dst, const std::vector<LinkPosition>& src,
+                     double LinkPosition::*field);
+
+  double m_exponent;
+  double m_referenceDistance;
+  double m_referenceLoss;
+
+  std::vector<double> m_edX, m_edY, m_edZ;
+  std::vector<double> m_gwX, m_gwY, m_gwZ;
+
+  bool m_dirty;                     //!< Positions or model changed since ComputePathLoss
+  std::vector<double> m_pathLoss;   //!< Log-distance loss (dB), [gw][ed]
+  std::vector<double> m_rxPower;    //!< Receive power (dBm), [gw][ed]
+  std::vector<uint32_t> m_bestGw;
+  std::vector<double> m_bestRxPower;
+
+  double m_maxRange;                   //!< 0 when every gateway is a candidate
+  bool m_candidatesDirty;              //!< Positions or range changed since ComputeCandidates
+  GatewayGrid m_grid;
+  std::vector<uint32_t> m_candStart;   //!< First candidate of each device, plus an end marker
+  std::vector<uint32_t> m_candidates;  //!< Candidate gateways, grouped by device
+};
+
+#endif /* LINK_BUDGET_H */
@@ -0,0 +1,148 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+/*
+ * Compile-time LoRa radio tables: time on air, demodulation SNR thresholds,
+ * gateway sensitivities and noise floors.
+ *
+ * The time on air follows the Semtech formula (SX1272 datasheet, 4.1.1.7),
+ * with an explicit header, a payload CRC, an 8-symbol preamble and the low
+ * data rate optimisation on whenever a symbol lasts more than 16 ms, as
+ * LoraPhy::GetOnAirTime does. Every SF7 .. SF12 x 125/250/500 kHz x
+ * CR 4/5 .. 4/8 x PHY payload 0 .. 255 combination is evaluated by the
+ * compiler into a symbol-count table, so a lookup is one load and one
+ * multiplication, and the allocator ToAs always match --payload.
+ */
+
+#ifndef LORA_TABLES_H
+#define LORA_TABLES_H
+
+#include <array>
+#include <cstdint>
+
+class LoraTables
+{
+public:
+  static constexpr uint32_t N_SF = 6;   //!< SF7 .. SF12
+  static constexpr uint32_t N_BW = 3;   //!< { 0: 125 kHz, 1: 250 kHz, 2: 500 kHz }
+  static constexpr uint32_t N_CR = 4;   //!< CR 4/5 .. 4/8
+  static constexpr uint32_t MAX_PHY_PAYLOAD = 255;
+  static constexpr uint32_t HEADER_BYTES = 9; //!< MAC + frame headers the lorawan module adds to an uplink
+
+  enum Bandwidth : uint8_t
+  {
+    BW125 = 0,
+    BW250 = 1,
+    BW500 = 2
+  };
+
+  static constexpr double BANDWIDTH_HZ[N_BW] = {125e3, 250e3, 500e3};
+
+  /// Demodulation SNR threshold (dB) for SF7 .. SF12
+  static constexpr double SNR_THRESHOLD[N_SF] = {-7.5, -10.0, -12.5, -15.0, -17.5, -20.0};
+
+  /// Gateway sensitivity (dBm) for SF7 .. SF12 at 125 kHz, as GatewayLoraPhy
+  static constexpr double GW_SENSITIVITY[N_SF] = {-130.0, -132.5, -135.0, -137.5, -140.0, -142.5};
+
+  /// Noise floor (dBm), -174 + 10 log10(BW) + NF, with the 6 dB noise figure of the gateways
+  static constexpr double NOISE_FLOOR[N_BW] = {-174 + 50.96910013008056 + 6,
+                                               -174 + 53.97940008672037 + 6,
+                                               -174 + 56.98970004336019 + 6};
+
+  /**
+   * \param sf Spreading factor, 7 .. 12.
+   * \param appPayload Application payload (bytes), the headers are added here;
+   *        appPayload + HEADER_BYTES must not exceed MAX_PHY_PAYLOAD.
+   * \param bw Bandwidth index.
+   * \param cr Coding rate 4/(4 + cr), 1 .. 4.
+   * \return The time on air (s) of the uplink.
+   */
+  static constexpr double TimeOnAir(uint8_t sf, uint32_t appPayload, Bandwidth bw = BW125, uint8_t cr = 1)
+  {
+    uint16_t quarters = s_quarterSymbols[Index(sf, appPayload + HEADER_BYTES, bw, cr)];
+    return quarters * ((1u << sf) / (4 * BANDWIDTH_HZ[bw]));
+  }
+
+  /**
+   * \return The SNR (dB) of a reception at rxPower (dBm).
+   */
+  static double Snr(double rxPower, Bandwidth bw = BW125)
+  {
+    return rxPower - NOISE_FLOOR[bw];
+  }
+
+  static bool IsValidPayload(int appPayload)
+  {
+    return appPayload >= 0 && appPayload + HEADER_BYTES <= MAX_PHY_PAYLOAD;
+  }
+
+private:
+  static constexpr uint32_t N_PAYLOAD = MAX_PHY_PAYLOAD + 1;
+
+  static constexpr uint32_t Index(uint32_t sf, uint32_t phyPayload, uint32_t bw, uint32_t cr)
+  {
+    return ((bw * N_CR + (cr - 1)) * N_SF + (sf - 7)) * N_PAYLOAD + phyPayload;
+  }
+
+  /**
+   * \return The length of the frame, preamble included, in quarter symbols
+   *         (the preamble lasts 12.25 symbols).
+   */
+  static constexpr uint16_t QuarterSymbols(uint32_t sf, uint32_t phyPayload, uint32_t bw, uint32_t cr)
+  {
+    // Symbols over 16 ms: 2^SF / BW > 0.016
+    bool ldro = (1u << sf) * 1000.0 > 16 * BANDWIDTH_HZ[bw];
+    int num = 8 * (int) phyPayload - 4 * (int) sf + 28 + 16;
+    int den = 4 * ((int) sf - (ldro ? 2 : 0));
+    int blocks = num > 0 ? (num + den - 1) / den : 0;
+    return (uint16_t) (4 * (8 + blocks * ((int) cr + 4)) + 49);
+  }
+
+  static constexpr std::array<uint16_t, N_BW * N_CR * N_SF * N_PAYLOAD> Build()
+  {
+    std::array<uint16_t, N_BW * N_CR * N_SF * N_PAYLOAD> table{};
+    for (uint32_t bw = 0; bw < N_BW; bw++)
+    {
+      for (uint32_t cr = 1; cr <= N_CR; cr++)
+      {
+        for (uint32_t sf = 7; sf <= 12; sf++)
+        {
+          for (uint32_t pl = 0; pl < N_PAYLOAD; pl++)
+          {
+            table[Index(sf, pl, bw, cr)] = QuarterSymbols(sf, pl, bw, cr);
+          }
+        }
+      }
+    }
+    return table;
+  }
+
+  /// Quarter symbols of every combination, see Index
+  static const std::array<uint16_t, N_BW * N_CR * N_SF * N_PAYLOAD> s_quarterSymbols;
+};
+
+// Defined out of the class, where Build is complete, and still evaluated by the compiler
+inline constexpr std::array<uint16_t, LoraTables::N_BW * LoraTables::N_CR * LoraTables::N_SF * LoraTables::N_PAYLOAD>
+  LoraTables::s_quarterSymbols = LoraTables::Build();
+
+/**
+ * \return true if the ToA of a 51-byte SF sf uplink is within tolerance of expected.
+ */
+constexpr bool
+LoraToaMatches(uint8_t sf, double expected, double tolerance)
+{
+  double error = LoraTables::TimeOnAir(sf, 51) - expected;
+  return error < tolerance && -error < tolerance;
+}
+
+// The table reproduces the SF7 .. SF12 ToAs the allocators used to hard-code,
+// the last two of which were rounded to six digits
+static_assert(LoraToaMatches(7, 0.112896, 1e-9), "SF7 ToA");
+static_assert(LoraToaMatches(8, 0.205312, 1e-9), "SF8 ToA");
+static_assert(LoraToaMatches(9, 0.369664, 1e-9), "SF9 ToA");
+static_assert(LoraToaMatches(10, 0.698368, 1e-9), "SF10 ToA");
+static_assert(LoraToaMatches(11, 1.47866, 5e-6), "SF11 ToA");
+static_assert(LoraToaMatches(12, 2.62963, 5e-6), "SF12 ToA");
+
+#endif /* LORA_TABLES_H */
@@ -0,0 +1,116 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "multi-stream-sender.h"
+
+#include "ns3/log.h"
+#include "ns3/lora-net-device.h"
+#include "ns3/packet.h"
+#include "ns3/simulator.h"
+
+namespace ns3
+{
+namespace lorawan
+{
+
+NS_LOG_COMPONENT_DEFINE("MultiStreamSender");
+
+NS_OBJECT_ENSURE_REGISTERED(MultiStreamSender);
+
+TypeId MultiStreamSender::GetTypeId()
+{
+  static TypeId tid = TypeId("ns3::MultiStreamSender")
+                          .SetParent<Application>()
+                          .AddConstructor<MultiStreamSender>()
+                          .SetGroupName("lorawan");
+  return tid;
+}
+
+MultiStreamSender::MultiStreamSender() : m_nextStream(0)
+{
+  // Unit mean, scaled by the interval of each stream, so one stream of
+  // random numbers serves all the message classes
+  m_gap = CreateObject<ExponentialRandomVariable>();
+}
+
+MultiStreamSender::~MultiStreamSender()
+{
+}
+
+void MultiStreamSender::AddStream(Time interval, MsgType msgType, uint8_t packetSize, Time firstArrival)
+{
+  m_streams.push_back({interval, msgType, packetSize, firstArrival, Time()});
+}
+
+void MultiStreamSender::DoDispose()
+{
+  m_mac = nullptr;
+  m_gap = nullptr;
+  Application::DoDispose();
+}
+
+void MultiStreamSender::StartApplication()
+{
+  NS_LOG_FUNCTION(this);
+
+  if (!m_mac)
+  {
+    Ptr<LoraNetDevice> dev = DynamicCast<LoraNetDevice>(GetNode()->GetDevice(0));
+    NS_ASSERT_MSG(dev, "MultiStreamSender needs a LoraNetDevice at index 0");
+    m_mac = dev->GetMac();
+  }
+
+  Time now = Simulator::Now();
+  for (Stream& stream : m_streams)
+  {
+    stream.m_next = now + stream.m_firstArrival;
+  }
+  ScheduleNext();
+}
+
+void MultiStreamSender::StopApplication()
+{
+  NS_LOG_FUNCTION(this);
+  Simulator::Cancel(m_sendEvent);
+}
+
+void MultiStreamSender::ScheduleNext()
+{
+  if (m_streams.empty())
+  {
+    return;
+  }
+
+  m_nextStream = 0;
+  for (uint32_t i = 1; i < m_streams.size(); i++)
+  {
+    if (m_streams[i].m_next < m_streams[m_nextStream].m_next)
+    {
+      m_nextStream = i;
+    }
+  }
+
+  m_sendEvent = Simulator::Schedule(m_streams[m_nextStream].m_next - Simulator::Now(),
+                                    &MultiStreamSender::SendNext,
+                                    this);
+}
+
+void MultiStreamSender::SendNext()
+{
+  NS_LOG_FUNCTION(this);
+
+  Stream& stream = m_streams[m_nextStream];
+
+  Ptr<Packet> packet = Create<Packet>(stream.m_packetSize);
+  AppTag tag;
+  tag.SetMsgType(stream.m_msgType);
+  packet->AddPacketTag(tag);
+  m_mac->Send(packet);
+
+  stream.m_next += Seconds(m_gap->GetValue() * stream.m_interval.GetSeconds());
+  ScheduleNext();
+}
+
+} // namespace lorawan
+} // namespace ns3
@@ -0,0 +1,91 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+/*
+ * One application generating k independent Poisson message streams.
+ *
+ * The IMR and PCC traffic of a meter used to be two PoissonSender
+ * applications, each with its own pending event. MultiStreamSender keeps the
+ * next arrival time of every stream and only schedules the earliest one,
+ * so a meter costs one Application object and one pending event whatever
+ * the number of message classes. Each stream is a Poisson process
+ * (exponential gaps with the stream's mean interval) and its packets carry
+ * the stream's AppTag message type.
+ */
+
+#ifndef MULTI_STREAM_SENDER_H
+#define MULTI_STREAM_SENDER_H
+
+#include "ns3/app-tag.h"
+#include "ns3/application.h"
+#include "ns3/lorawan-mac.h"
+#include "ns3/nstime.h"
+#include "ns3/random-variable-stream.h"
+
+#include <vector>
+
+namespace ns3
+{
+namespace lorawan
+{
+
+class MultiStreamSender : public Application
+{
+public:
+  static TypeId GetTypeId();
+
+  MultiStreamSender();
+  ~MultiStreamSender() override;
+
+  /**
+   * Add a message stream, before the application starts.
+   *
+   * \param interval Mean time between two messages of the stream.
+   * \param msgType AppTag message type of its packets.
+   * \param packetSize Payload size (bytes).
+   * \param firstArrival Delay of the first message after the application starts.
+   */
+  void AddStream(Time interval, MsgType msgType, uint8_t packetSize, Time firstArrival);
+
+  uint32_t GetNStreams() const
+  {
+    return (uint32_t) m_streams.size();
+  }
+
+protected:
+  void DoDispose() override;
+  void StartApplication() override;
+  void StopApplication() override;
+
+private:
+  struct Stream
+  {
+    Time m_interval;
+    MsgType m_msgType;
+    uint8_t m_packetSize;
+    Time m_firstArrival;
+    Time m_next; //!< Absolute time of the next message
+  };
+
+  /**
+   * Schedule the single pending event at the earliest next arrival.
+   */
+  void ScheduleNext();
+
+  /**
+   * Send the message of the earliest stream and draw its next arrival.
+   */
+  void SendNext();
+
+  std::vector<Stream> m_streams;
+  uint32_t m_nextStream; //!< Stream of the pending event
+  EventId m_sendEvent;
+  Ptr<LorawanMac> m_mac;
+  Ptr<ExponentialRandomVariable> m_gap; //!< Gap, in units of the stream interval
+};
+
+} // namespace lorawan
+} // namespace ns3
+
+#endif /* MULTI_STREAM_SENDER_H */
@@ -0,0 +1,61 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "outcome-tracer.h"
+
+#include <cstring>
+
+OutcomeTracer::OutcomeTracer() : m_file(nullptr), m_n(0)
+{
+}
+
+OutcomeTracer::~OutcomeTracer()
+{
+  Close();
+}
+
+bool OutcomeTracer::Open(const std::string& fileName, uint32_t nRun, size_t bufferRecords)
+{
+  Close();
+
+  m_file = fopen(fileName.c_str(), "wb");
+  if (!m_file)
+  {
+    return false;
+  }
+
+  OutcomeFileHeader header;
+  memcpy(header.m_magic, "SBOT", 4);
+  header.m_version = 1;
+  header.m_recordSize = sizeof(OutcomeRecord);
+  header.m_nRun = nRun;
+  fwrite(&header, sizeof(header), 1, m_file);
+
+  m_buffer.resize(bufferRecords > 0 ? bufferRecords : 1);
+  m_n = 0;
+  return true;
+}
+
+void OutcomeTracer::Flush()
+{
+  if (m_n > 0)
+  {
+    fwrite(m_buffer.data(), sizeof(OutcomeRecord), m_n, m_file);
+    m_n = 0;
+  }
+}
+
+void OutcomeTracer::Close()
+{
+  if (!m_file)
+  {
+    return;
+  }
+
+  Flush();
+  fclose(m_file);
+  m_file = nullptr;
+
+  std::vector<OutcomeRecord>().swap(m_buffer);
+}
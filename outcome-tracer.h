@@ -0,0 +1,109 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+/*
+ * Opt-in per-packet outcome trace.
+ *
+ * Every transmission of an uplink becomes one fixed-size binary record
+ * holding its outcome consolidated over all the gateways. The records are
+ * collected in a buffer allocated once when the trace is opened and written
+ * out with one fwrite per full buffer. A closed tracer owns no memory, so
+ * the callbacks only pay the IsEnabled() branch.
+ *
+ * File layout: OutcomeFileHeader followed by OutcomeRecord entries, in host
+ * byte order.
+ */
+
+#ifndef OUTCOME_TRACER_H
+#define OUTCOME_TRACER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+enum PktOutcome
+{
+  OUTCOME_OK,
+  OUTCOME_EXPIRED,
+  OUTCOME_INTERF,
+  OUTCOME_UNDER,
+  OUTCOME_NO_MORE,
+  OUTCOME_BUSY
+};
+
+struct OutcomeFileHeader
+{
+  char m_magic[4];       //!< "SBOT"
+  uint32_t m_version;    //!< Format version, currently 1
+  uint32_t m_recordSize; //!< sizeof(OutcomeRecord)
+  uint32_t m_nRun;       //!< Run that produced the trace
+};
+
+struct OutcomeRecord
+{
+  uint64_t m_uid;    //!< ns-3 packet UID
+  int64_t m_timeNs;  //!< Simulation time of the event (ns)
+  uint32_t m_gwId;   //!< Node id of the gateway with the best receive power
+  uint8_t m_outcome; //!< PktOutcome
+  uint8_t m_sf;      //!< Spreading factor of the transmission
+  uint8_t m_appType; //!< MsgType of the AppTag (IMR, PCC)
+  uint8_t m_pad;
+};
+
+static_assert(sizeof(OutcomeRecord) == 24, "OutcomeRecord must stay 24 bytes");
+
+class OutcomeTracer
+{
+public:
+  OutcomeTracer();
+  ~OutcomeTracer();
+
+  /**
+   * Start tracing to fileName (truncated).
+   *
+   * \param fileName Output file.
+   * \param nRun Run number stored in the file header.
+   * \param bufferRecords Number of records buffered between writes.
+   * \return false if the file could not be opened.
+   */
+  bool Open(const std::string& fileName, uint32_t nRun, size_t bufferRecords = 8192);
+
+  bool IsEnabled() const
+  {
+    return m_file != nullptr;
+  }
+
+  void Record(uint64_t uid, int64_t timeNs, uint32_t gwId, PktOutcome outcome,
+              uint8_t sf, uint8_t appType)
+  {
+    OutcomeRecord& rec = m_buffer[m_n++];
+    rec.m_uid = uid;
+    rec.m_timeNs = timeNs;
+    rec.m_gwId = gwId;
+    rec.m_outcome = (uint8_t) outcome;
+    rec.m_sf = sf;
+    rec.m_appType = appType;
+    rec.m_pad = 0;
+
+    if (m_n == m_buffer.size())
+    {
+      Flush();
+    }
+  }
+
+  /**
+   * Write the pending records, close the file and release the buffer.
+   */
+  void Close();
+
+private:
+  void Flush();
+
+  FILE* m_file;
+  std::vector<OutcomeRecord> m_buffer;
+  size_t m_n; //!< Records pending in m_buffer
+};
+
+#endif /* OUTCOME_TRACER_H */
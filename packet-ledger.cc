@@ -0,0 +1,133 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "packet-ledger.h"
+
+#include <algorithm>
+
+// Bound to const references by resize
+const uint32_t PacketLedger::NONE;
+
+PacketLedger::PacketLedger() : m_baseUid(0), m_hasBase(false)
+{
+}
+
+void PacketLedger::Reserve(uint32_t nPackets)
+{
+  m_uid.reserve(nPackets);
+  m_txTime.reserve(nPackets);
+  m_delay.reserve(nPackets);
+  m_cpsrDelay.reserve(nPackets);
+  m_status.reserve(nPackets);
+  m_edId.reserve(nPackets);
+  m_appType.reserve(nPackets);
+  m_sf.reserve(nPackets);
+  m_window.reserve(nPackets);
+
+  // UIDs are shared with ACKs and other packets created during the run, so
+  // the UID range is wider than the number of uplinks
+  m_uidIndex.reserve(2 * (size_t) nPackets);
+}
+
+uint32_t PacketLedger::Insert(uint64_t uid, int edId, double txTime, uint8_t appType, uint8_t sf)
+{
+  if (!m_hasBase)
+  {
+    m_baseUid = uid;
+    m_hasBase = true;
+  }
+
+  // UIDs are given at creation and the duty cycle delays sends, so a packet
+  // sent late may come below the start of the index
+  if (uid < m_baseUid)
+  {
+    m_uidIndex.insert(m_uidIndex.begin(), m_baseUid - uid, NONE);
+    m_baseUid = uid;
+  }
+
+  uint64_t offset = uid - m_baseUid;
+  if (offset >= m_uidIndex.size())
+  {
+    size_t size = std::max<size_t>(offset + 1, 2 * m_uidIndex.size());
+    m_uidIndex.resize(size, NONE);
+  }
+
+  uint32_t id = GetN();
+  m_uidIndex[offset] = id;
+
+  m_uid.push_back(uid);
+  m_txTime.push_back(txTime);
+  m_delay.push_back(-1);
+  m_cpsrDelay.push_back(-1);
+  m_status.push_back(SENT);
+  m_edId.push_back(edId);
+  m_appType.push_back(appType);
+  m_sf.push_back(sf);
+  m_window.push_back(NONE);
+
+  return id;
+}
+
+uint32_t PacketLedger::Retire(double beforeMs)
+{
+  uint32_t n = 0;
+  while (n < GetN() && m_txTime[n] < beforeMs && m_window[n] == NONE)
+  {
+    n++;
+  }
+  if (n == 0)
+  {
+    return 0;
+  }
+  if (n == GetN())
+  {
+    Clear();
+    return n;
+  }
+
+  m_uid.erase(m_uid.begin(), m_uid.begin() + n);
+  m_txTime.erase(m_txTime.begin(), m_txTime.begin() + n);
+  m_delay.erase(m_delay.begin(), m_delay.begin() + n);
+  m_cpsrDelay.erase(m_cpsrDelay.begin(), m_cpsrDelay.begin() + n);
+  m_status.erase(m_status.begin(), m_status.begin() + n);
+  m_edId.erase(m_edId.begin(), m_edId.begin() + n);
+  m_appType.erase(m_appType.begin(), m_appType.begin() + n);
+  m_sf.erase(m_sf.begin(), m_sf.begin() + n);
+  m_window.erase(m_window.begin(), m_window.begin() + n);
+
+  for (uint32_t& id : m_uidIndex)
+  {
+    if (id != NONE)
+    {
+      id = id < n ? NONE : id - n;
+    }
+  }
+
+  // UIDs are not in transmission order, so a remaining packet may have a
+  // lower UID than a retired one; only the leading run of retired UIDs goes
+  size_t shift = 0;
+  while (shift < m_uidIndex.size() && m_uidIndex[shift] == NONE)
+  {
+    shift++;
+  }
+  m_uidIndex.erase(m_uidIndex.begin(), m_uidIndex.begin() + shift);
+  m_baseUid += shift;
+  return n;
+}
+
+void PacketLedger::Clear()
+{
+  m_uid.clear();
+  m_txTime.clear();
+  m_delay.clear();
+  m_cpsrDelay.clear();
+  m_status.clear();
+  m_edId.clear();
+  m_appType.clear();
+  m_sf.clear();
+  m_window.clear();
+  m_uidIndex.clear();
+  m_hasBase = false;
+  m_baseUid = 0;
+}
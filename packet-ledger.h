@@ -0,0 +1,104 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+/*
+ * Dense per-run ledger of the uplink packets sent by the end devices.
+ *
+ * Packets are identified by their 64-bit ns-3 UID. Each new UID gets a
+ * compact id (0, 1, 2, ...) and every field lives in its own flat array
+ * indexed by that id, so the trace callbacks pay one bounds check and one
+ * array access instead of a tree lookup per event.
+ *
+ * For long runs the oldest packets can be retired: ids are handed out in
+ * transmission order, so the retired packets are always a prefix of the
+ * arrays, which is erased while the ids of the remaining packets shift
+ * down by the same amount. The memory then follows the number of packets
+ * still in flight rather than the length of the run. UIDs are given at
+ * creation, though, and the duty cycle delays sends, so UIDs are not in
+ * transmission order: the UID index only drops its leading run of retired
+ * UIDs and grows downwards for a late packet below its start.
+ */
+
+#ifndef PACKET_LEDGER_H
+#define PACKET_LEDGER_H
+
+#include <cstdint>
+#include <vector>
+
+enum PktStatus
+{
+  SENT,
+  OK,
+  LOST,
+  EXPIRED
+};
+
+struct PacketLedger
+{
+  static const uint32_t NONE = UINT32_MAX; //!< Returned by Find for unknown UIDs
+
+  PacketLedger();
+
+  /**
+   * Preallocate room for nPackets uplinks.
+   *
+   * \param nPackets Expected number of distinct uplink packets in the run.
+   */
+  void Reserve(uint32_t nPackets);
+
+  /**
+   * Register a new uplink packet.
+   *
+   * \return The compact id assigned to the packet.
+   */
+  uint32_t Insert(uint64_t uid, int edId, double txTime, uint8_t appType, uint8_t sf);
+
+  /**
+   * \return The compact id of the packet with the given UID, or NONE.
+   */
+  uint32_t Find(uint64_t uid) const
+  {
+    if (!m_hasBase || uid < m_baseUid || uid - m_baseUid >= m_uidIndex.size())
+    {
+      return NONE;
+    }
+    return m_uidIndex[uid - m_baseUid];
+  }
+
+  uint32_t GetN() const
+  {
+    return (uint32_t) m_txTime.size();
+  }
+
+  /**
+   * Forget the packets first sent before beforeMs that have no open
+   * aggregator window, up to the first one that does not qualify. Find
+   * returns NONE for them afterwards.
+   *
+   * \param beforeMs Transmission time (ms) limit.
+   * \return How many packets were retired, i.e. how much every remaining
+   *         id went down.
+   */
+  uint32_t Retire(double beforeMs);
+
+  void Clear();
+
+  // Structure of arrays, indexed by compact id
+  std::vector<uint64_t> m_uid;     //!< ns-3 packet UID
+  std::vector<double> m_txTime;    //!< Time of the first transmission (ms)
+  std::vector<double> m_delay;     //!< Delay of the first reception (ms), -1 if none
+  std::vector<double> m_cpsrDelay; //!< Delay until the ACK of a confirmed uplink (ms), -1 if none
+  std::vector<uint8_t> m_status;   //!< PktStatus
+  std::vector<int32_t> m_edId;     //!< Index of the sending end device
+  std::vector<uint8_t> m_appType;  //!< MsgType of the AppTag (IMR, PCC)
+  std::vector<uint8_t> m_sf;       //!< Spreading factor of the first transmission
+  std::vector<uint32_t> m_window;  //!< Open UplinkAggregator window, NONE if none
+
+private:
+  std::vector<uint32_t> m_uidIndex; //!< (uid - m_baseUid) -> compact id
+  uint64_t m_baseUid;               //!< Lowest UID the index covers
+  bool m_hasBase;
+};
+
+#endif /* PACKET_LEDGER_H */
@@ -0,0 +1,168 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "pcc-priority.h"
+
+#include "ns3/app-tag.h"
+#include "ns3/lora-net-device.h"
+#include "ns3/lorawan-mac.h"
+#include "ns3/mobility-model.h"
+#include "ns3/simulator.h"
+
+namespace ns3
+{
+
+using namespace lorawan;
+
+NS_OBJECT_ENSURE_REGISTERED(PriorityGatewayLoraPhy);
+NS_OBJECT_ENSURE_REGISTERED(PriorityPacketQueue);
+
+static bool
+IsPcc(Ptr<const Packet> packet)
+{
+  AppTag tag;
+  return packet->PeekPacketTag(tag) && tag.GetMsgType() == PCC;
+}
+
+TypeId PriorityGatewayLoraPhy::GetTypeId()
+{
+  static TypeId tid = TypeId("ns3::PriorityGatewayLoraPhy")
+                          .SetParent<SimpleGatewayLoraPhy>()
+                          .SetGroupName("lorawan")
+                          .AddConstructor<PriorityGatewayLoraPhy>();
+  return tid;
+}
+
+PriorityGatewayLoraPhy::PriorityGatewayLoraPhy()
+{
+}
+
+PriorityGatewayLoraPhy::~PriorityGatewayLoraPhy()
+{
+}
+
+void PriorityGatewayLoraPhy::StartReceive(Ptr<Packet> packet, double rxPowerDbm, uint8_t sf,
+                                          Time duration, double frequencyMHz)
+{
+  // Only a PCC uplink that SimpleGatewayLoraPhy would lock on if a path were free
+  if (!m_isTransmitting && IsOnFrequency(frequencyMHz) && rxPowerDbm >= sensitivity[sf - 7]
+      && IsPcc(packet))
+  {
+    bool full = true;
+    Ptr<ReceptionPath> victim;
+    for (auto& path : m_receptionPaths)
+    {
+      if (path->IsAvailable())
+      {
+        full = false;
+        break;
+      }
+      Ptr<LoraInterferenceHelper::Event> event = path->GetEvent();
+      if (!IsPcc(event->GetPacket())
+          && (!victim || event->GetEndTime() > victim->GetEvent()->GetEndTime()))
+      {
+        victim = path;
+      }
+    }
+
+    if (full && victim)
+    {
+      // The IMR reception never reaches EndReceive, its signal still
+      // interferes with the others
+      Ptr<Packet> lost = victim->GetEvent()->GetPacket();
+      Simulator::Cancel(victim->GetEndReceive());
+      victim->Free();
+      m_occupiedReceptionPaths--;
+      m_noMoreDemodulators(lost, m_device->GetNode()->GetId());
+    }
+  }
+
+  SimpleGatewayLoraPhy::StartReceive(packet, rxPowerDbm, sf, duration, frequencyMHz);
+}
+
+void PriorityGatewayLoraPhy::Install(const NodeContainer& gateways, Ptr<LoraChannel> channel)
+{
+  for (uint32_t i = 0; i < gateways.GetN(); i++)
+  {
+    Ptr<Node> node = gateways.Get(i);
+    Ptr<LoraNetDevice> dev = DynamicCast<LoraNetDevice>(node->GetDevice(0));
+    Ptr<LorawanMac> mac = dev->GetMac();
+
+    Ptr<PriorityGatewayLoraPhy> phy = CreateObject<PriorityGatewayLoraPhy>();
+    phy->SetDevice(dev);
+    phy->SetMobility(node->GetObject<MobilityModel>());
+    phy->SetChannel(channel);
+    for (double frequency : {868.1, 868.3, 868.5})
+    {
+      phy->AddFrequency(frequency);
+    }
+    for (int path = 0; path < 8; path++)
+    {
+      phy->AddReceptionPath();
+    }
+    phy->SetReceiveOkCallback(MakeCallback(&LorawanMac::Receive, mac));
+    phy->SetTxFinishedCallback(MakeCallback(&LorawanMac::TxFinished, mac));
+
+    // Removed and added in gateway order, after every end device
+    channel->Remove(dev->GetPhy());
+    channel->Add(phy);
+    dev->SetPhy(phy);
+    mac->SetPhy(phy);
+  }
+}
+
+TypeId PriorityPacketQueue::GetTypeId()
+{
+  // Queue helpers append the item type to the name they look up
+  static TypeId tid =
+      TypeId("ns3::PriorityPacketQueue<Packet>")
+          .SetParent<Queue<Packet>>()
+          .SetGroupName("Network")
+          .AddConstructor<PriorityPacketQueue>()
+          .AddAttribute("MaxSize",
+                        "The max queue size",
+                        QueueSizeValue(QueueSize("100p")),
+                        MakeQueueSizeAccessor(&QueueBase::SetMaxSize, &QueueBase::GetMaxSize),
+                        MakeQueueSizeChecker());
+  return tid;
+}
+
+PriorityPacketQueue::PriorityPacketQueue()
+{
+}
+
+PriorityPacketQueue::~PriorityPacketQueue()
+{
+}
+
+bool PriorityPacketQueue::Enqueue(Ptr<Packet> packet)
+{
+  auto pos = GetContainer().end();
+  if (IsPcc(packet))
+  {
+    pos = GetContainer().begin();
+    while (pos != GetContainer().end() && IsPcc(*pos))
+    {
+      pos++;
+    }
+  }
+  return DoEnqueue(pos, packet);
+}
+
+Ptr<Packet> PriorityPacketQueue::Dequeue()
+{
+  return DoDequeue(GetContainer().begin());
+}
+
+Ptr<Packet> PriorityPacketQueue::Remove()
+{
+  return DoRemove(GetContainer().begin());
+}
+
+Ptr<const Packet> PriorityPacketQueue::Peek() const
+{
+  return DoPeek(GetContainer().begin());
+}
+
+} // namespace ns3
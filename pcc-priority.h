@@ -0,0 +1,70 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+/*
+ * Priority of the PCC (billing) uplinks over the IMR ones.
+ *
+ * PriorityGatewayLoraPhy is the SimpleGatewayLoraPhy of the lorawan module
+ * with one change: a decodable PCC uplink that finds every reception path
+ * locked takes over the IMR reception that would end last, which is then
+ * reported lost for lack of demodulators. LoraPhyHelper always creates
+ * SimpleGatewayLoraPhy, so Install swaps the PHY of each gateway once the
+ * helpers have run. PriorityPacketQueue is a drop-tail queue that puts a
+ * PCC packet in front of the queued IMR ones, for the point-to-point links
+ * between the gateways and the network server.
+ */
+
+#ifndef PCC_PRIORITY_H
+#define PCC_PRIORITY_H
+
+#include "ns3/lora-channel.h"
+#include "ns3/node-container.h"
+#include "ns3/queue.h"
+#include "ns3/simple-gateway-lora-phy.h"
+
+namespace ns3
+{
+
+class PriorityGatewayLoraPhy : public lorawan::SimpleGatewayLoraPhy
+{
+public:
+  static TypeId GetTypeId();
+
+  PriorityGatewayLoraPhy();
+  ~PriorityGatewayLoraPhy() override;
+
+  void StartReceive(Ptr<Packet> packet, double rxPowerDbm, uint8_t sf, Time duration,
+                    double frequencyMHz) override;
+
+  /**
+   * Replace the PHY of every gateway by a PriorityGatewayLoraPhy with the
+   * same device, mobility and channel, and the EU868 frequencies and eight
+   * reception paths LorawanMacHelper gives a gateway. Call right after
+   * LoraHelper::Install, before any handle to the PHYs is taken; the
+   * gateways keep their order on the channel.
+   */
+  static void Install(const NodeContainer& gateways, Ptr<lorawan::LoraChannel> channel);
+};
+
+class PriorityPacketQueue : public Queue<Packet>
+{
+public:
+  static TypeId GetTypeId();
+
+  PriorityPacketQueue();
+  ~PriorityPacketQueue() override;
+
+  /**
+   * Append packet, or insert it before the first non-PCC packet if it is a
+   * PCC one. Drops it if the queue is full.
+   */
+  bool Enqueue(Ptr<Packet> packet) override;
+  Ptr<Packet> Dequeue() override;
+  Ptr<Packet> Remove() override;
+  Ptr<const Packet> Peek() const override;
+};
+
+} // namespace ns3
+
+#endif /* PCC_PRIORITY_H */
@@ -0,0 +1,71 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "phase-timer.h"
+
+#include <fstream>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+void PhaseTimer::Begin(const std::string& name)
+{
+  End();
+  m_current = name;
+  m_start = std::chrono::steady_clock::now();
+}
+
+void PhaseTimer::End()
+{
+  if (m_current.empty())
+  {
+    return;
+  }
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_start;
+  m_phases.push_back({m_current, elapsed.count()});
+  m_current.clear();
+}
+
+double PhaseTimer::Get(const std::string& name) const
+{
+  double seconds = 0;
+  for (const Phase& phase : m_phases)
+  {
+    if (phase.m_name == name)
+    {
+      seconds += phase.m_seconds;
+    }
+  }
+  return seconds;
+}
+
+void PhaseTimer::Clear()
+{
+  m_phases.clear();
+  m_current.clear();
+}
+
+long PhaseTimer::PeakRssKb()
+{
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+  {
+    return 0;
+  }
+  return usage.ru_maxrss; // KiB on Linux
+}
+
+long PhaseTimer::CurrentRssKb()
+{
+  // statm: total and resident pages
+  std::ifstream statm("/proc/self/statm");
+  long pages = 0;
+  long residentPages = 0;
+  if (!(statm >> pages >> residentPages))
+  {
+    return 0;
+  }
+  return residentPages * (sysconf(_SC_PAGESIZE) / 1024);
+}
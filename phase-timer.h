@@ -0,0 +1,68 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+/*
+ * Wall-clock timing of the phases of a run, plus the peak and current
+ * resident set size of the process, for --perfReport and the progress
+ * reports.
+ */
+
+#ifndef PHASE_TIMER_H
+#define PHASE_TIMER_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+class PhaseTimer
+{
+public:
+  struct Phase
+  {
+    std::string m_name;
+    double m_seconds;
+  };
+
+  /**
+   * Close the current phase, if any, and start timing name.
+   */
+  void Begin(const std::string& name);
+
+  /**
+   * Close the current phase.
+   */
+  void End();
+
+  /**
+   * \return The closed phases, in the order they ran.
+   */
+  const std::vector<Phase>& GetPhases() const
+  {
+    return m_phases;
+  }
+
+  /**
+   * \return The duration (s) of the closed phase name, 0 if it did not run.
+   */
+  double Get(const std::string& name) const;
+
+  void Clear();
+
+  /**
+   * \return Peak resident set size of the process so far (KiB).
+   */
+  static long PeakRssKb();
+
+  /**
+   * \return Current resident set size of the process (KiB), 0 if unknown.
+   */
+  static long CurrentRssKb();
+
+private:
+  std::vector<Phase> m_phases;
+  std::string m_current;
+  std::chrono::steady_clock::time_point m_start;
+};
+
+#endif /* PHASE_TIMER_H */
@@ -0,0 +1,62 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "radio-energy-account.h"
+
+#include <cmath>
+
+void RadioEnergyAccount::Setup(uint32_t nDevices, const RadioCurrents& currents, State initialState)
+{
+  m_currents = currents;
+  Account account;
+  account.m_since = 0;
+  account.m_energyJ = 0;
+  account.m_currentA = (float) Current(initialState, 0);
+  account.m_state = initialState;
+  m_accounts.assign(nDevices, account);
+}
+
+void RadioEnergyAccount::ChangeState(uint32_t edId, double nowS, uint8_t newState, double txPowerDbm)
+{
+  Account& account = m_accounts[edId];
+  account.m_energyJ += account.m_currentA * m_currents.m_voltageV * (nowS - account.m_since);
+  account.m_since = nowS;
+  account.m_currentA = (float) Current(newState, txPowerDbm);
+  account.m_state = newState;
+}
+
+double RadioEnergyAccount::GetTotalEnergy(uint32_t edId, double nowS) const
+{
+  const Account& account = m_accounts[edId];
+  return account.m_energyJ + account.m_currentA * m_currents.m_voltageV * (nowS - account.m_since);
+}
+
+double RadioEnergyAccount::TxCurrent(double txPowerDbm) const
+{
+  // LinearLoraTxCurrentModel: P_tx / (V * eta) + I_idle
+  double txPowerW = std::pow(10.0, (txPowerDbm - 30) / 10);
+  return txPowerW / (m_currents.m_voltageV * m_currents.m_eta) + m_currents.m_txIdleA;
+}
+
+double RadioEnergyAccount::Current(uint8_t state, double txPowerDbm) const
+{
+  switch (state)
+  {
+    case SLEEP:
+      return m_currents.m_sleepA;
+    case STANDBY:
+      return m_currents.m_standbyA;
+    case TX:
+      return TxCurrent(txPowerDbm);
+    case RX:
+      return m_currents.m_rxA;
+  }
+  return 0;
+}
+
+void RadioEnergyAccount::Clear()
+{
+  m_accounts.clear();
+  m_accounts.shrink_to_fit();
+}
@@ -0,0 +1,92 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+/*
+ * Analytic radio energy accounting of the end devices.
+ *
+ * The energy source and radio energy model installed by the ns-3 helpers
+ * cost two objects per device and a periodic update event per source, while
+ * the scenario only reads the total consumption at the end of a run. This
+ * table integrates current x voltage over the time spent in each PHY state
+ * from the state transitions alone: one 24-byte account per device, updated
+ * when the radio changes state, and no event of its own. The currents and
+ * the linear TX current model are those configured on the helpers.
+ */
+
+#ifndef RADIO_ENERGY_ACCOUNT_H
+#define RADIO_ENERGY_ACCOUNT_H
+
+#include <cstdint>
+#include <vector>
+
+struct RadioCurrents
+{
+  double m_voltageV = 3.3;
+  double m_standbyA = 0.0014;
+  double m_sleepA = 0.0000015;
+  double m_rxA = 0.0112;
+  double m_eta = 0.10;        //!< PA efficiency of the linear TX current model
+  double m_txIdleA = 0.0002;  //!< Idle current of the linear TX current model
+};
+
+class RadioEnergyAccount
+{
+public:
+  //! Same order as EndDeviceLoraPhy::State
+  enum State : uint8_t
+  {
+    SLEEP,
+    STANDBY,
+    TX,
+    RX
+  };
+
+  /**
+   * Open one account per device, all in initialState at time 0, discarding
+   * the previous run.
+   */
+  void Setup(uint32_t nDevices, const RadioCurrents& currents, State initialState);
+
+  bool IsEnabled() const
+  {
+    return !m_accounts.empty();
+  }
+
+  /**
+   * Close the interval spent in the previous state and enter newState.
+   *
+   * \param nowS Time of the transition (s).
+   * \param txPowerDbm Transmission power, only used when newState is TX.
+   */
+  void ChangeState(uint32_t edId, double nowS, uint8_t newState, double txPowerDbm);
+
+  /**
+   * \return The energy (J) consumed by the device up to nowS, including the
+   *         interval still open in the current state.
+   */
+  double GetTotalEnergy(uint32_t edId, double nowS) const;
+
+  /**
+   * \return The current (A) drawn by the linear TX current model at txPowerDbm.
+   */
+  double TxCurrent(double txPowerDbm) const;
+
+  void Clear();
+
+private:
+  struct Account
+  {
+    double m_since;    //!< Time the current state was entered (s)
+    double m_energyJ;  //!< Energy of the closed intervals
+    float m_currentA;  //!< Current drawn in the current state
+    uint8_t m_state;
+  };
+
+  double Current(uint8_t state, double txPowerDbm) const;
+
+  std::vector<Account> m_accounts;
+  RadioCurrents m_currents;
+};
+
+#endif /* RADIO_ENERGY_ACCOUNT_H */
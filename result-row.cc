@@ -0,0 +1,82 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "result-row.h"
+
+#include <sstream>
+
+void ResultRow::AddInt(const std::string& name, int64_t value, bool inCsv)
+{
+  m_columns.push_back({name, true, inCsv, value, 0.0});
+}
+
+void ResultRow::AddDouble(const std::string& name, double value, bool inCsv)
+{
+  m_columns.push_back({name, false, inCsv, 0, value});
+}
+
+std::string ResultRow::ToCsv() const
+{
+  std::ostringstream oss;
+  bool first = true;
+  for (const Column& col : m_columns)
+  {
+    if (!col.m_inCsv)
+    {
+      continue;
+    }
+
+    if (!first)
+    {
+      oss << ",";
+    }
+    first = false;
+
+    if (col.m_isInt)
+    {
+      oss << col.m_int;
+    }
+    else
+    {
+      oss << col.m_double;
+    }
+  }
+  oss << std::endl;
+  return oss.str();
+}
+
+std::string ResultRow::Schema() const
+{
+  std::string header("SBRR", 4);
+  uint32_t version = 1;
+  uint32_t nColumns = (uint32_t) m_columns.size();
+  header.append(reinterpret_cast<const char*>(&version), sizeof(version));
+  header.append(reinterpret_cast<const char*>(&nColumns), sizeof(nColumns));
+
+  for (const Column& col : m_columns)
+  {
+    header.push_back(col.m_isInt ? 0 : 1);
+    header.push_back((char) col.m_name.size());
+    header.append(col.m_name);
+  }
+  return header;
+}
+
+std::string ResultRow::ToBinary() const
+{
+  std::string record;
+  record.reserve(8 * m_columns.size());
+  for (const Column& col : m_columns)
+  {
+    if (col.m_isInt)
+    {
+      record.append(reinterpret_cast<const char*>(&col.m_int), sizeof(col.m_int));
+    }
+    else
+    {
+      record.append(reinterpret_cast<const char*>(&col.m_double), sizeof(col.m_double));
+    }
+  }
+  return record;
+}
@@ -0,0 +1,69 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+/*
+ * One row of a result table, kept as typed named columns so that it can be
+ * written both as the legacy headerless CSV line and as a fixed-layout
+ * binary record.
+ *
+ * Binary layout (host byte order):
+ *   header: "SBRR", uint32 version (1), uint32 column count, then for each
+ *           column uint8 type (0: int64, 1: float64), uint8 name length and
+ *           the name bytes;
+ *   rows:   column count x 8 bytes.
+ */
+
+#ifndef RESULT_ROW_H
+#define RESULT_ROW_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ResultRow
+{
+public:
+  /**
+   * Add an integer column.
+   *
+   * \param name Column name in the binary schema.
+   * \param value Column value.
+   * \param inCsv Whether the column is part of the CSV line.
+   */
+  void AddInt(const std::string& name, int64_t value, bool inCsv = true);
+
+  /**
+   * Add a floating point column.
+   */
+  void AddDouble(const std::string& name, double value, bool inCsv = true);
+
+  /**
+   * \return The CSV line, formatted as std::ostream does by default.
+   */
+  std::string ToCsv() const;
+
+  /**
+   * \return The binary file header describing the columns of this row.
+   */
+  std::string Schema() const;
+
+  /**
+   * \return The binary record of this row.
+   */
+  std::string ToBinary() const;
+
+private:
+  struct Column
+  {
+    std::string m_name;
+    bool m_isInt;
+    bool m_inCsv;
+    int64_t m_int;
+    double m_double;
+  };
+
+  std::vector<Column> m_columns;
+};
+
+#endif /* RESULT_ROW_H */
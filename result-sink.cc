@@ -0,0 +1,103 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "result-sink.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+ResultSink::~ResultSink()
+{
+  Commit();
+  Close();
+}
+
+void ResultSink::Append(const std::string& fileName, const std::string& content)
+{
+  m_files[fileName].m_pending += content;
+}
+
+void ResultSink::SetHeader(const std::string& fileName, const std::string& header)
+{
+  m_files[fileName].m_header = header;
+}
+
+/**
+ * Take or release a write lock on the whole file.
+ */
+static void
+LockFile(int fd, short type)
+{
+  struct flock lock;
+  memset(&lock, 0, sizeof(lock));
+  lock.l_type = type;
+  lock.l_whence = SEEK_SET;
+  while (fcntl(fd, F_SETLKW, &lock) < 0 && errno == EINTR)
+  {
+  }
+}
+
+bool ResultSink::Commit()
+{
+  bool ok = true;
+  for (auto& entry : m_files)
+  {
+    File& file = entry.second;
+    if (file.m_pending.empty())
+    {
+      continue;
+    }
+
+    int fd = open(entry.first.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0)
+    {
+      std::cerr << "Cannot open " << entry.first << ": " << strerror(errno) << std::endl;
+      ok = false;
+      continue;
+    }
+
+    LockFile(fd, F_WRLCK);
+
+    struct stat st;
+    if (!file.m_header.empty() && fstat(fd, &st) == 0 && st.st_size == 0)
+    {
+      file.m_pending.insert(0, file.m_header);
+    }
+    ssize_t n = write(fd, file.m_pending.data(), file.m_pending.size());
+
+    LockFile(fd, F_UNLCK);
+    close(fd);
+
+    if (n != (ssize_t) file.m_pending.size())
+    {
+      std::cerr << "Short write to " << entry.first << std::endl;
+      ok = false;
+    }
+  }
+  // Headers are set again with the rows of the next run
+  m_files.clear();
+  return ok;
+}
+
+void ResultSink::Drain(RowWriter writer)
+{
+  for (auto& entry : m_files)
+  {
+    if (!entry.second.m_pending.empty())
+    {
+      writer(entry.first, entry.second.m_header, entry.second.m_pending);
+    }
+  }
+  m_files.clear();
+}
+
+void ResultSink::Close()
+{
+  m_files.clear();
+}
@@ -0,0 +1,71 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+/*
+ * Buffered result writer.
+ *
+ * Rows are kept in memory per file until the run is committed. A commit
+ * opens each file (O_APPEND), writes all the pending rows of the file with a
+ * single write() under an fcntl write lock and closes it again, so a sweep
+ * over thousands of cell directories never holds more than one descriptor.
+ * Concurrent processes appending to the same file (also on NFS, where
+ * O_APPEND alone is not atomic) therefore never interleave inside a run.
+ */
+
+#ifndef RESULT_SINK_H
+#define RESULT_SINK_H
+
+#include <functional>
+#include <map>
+#include <string>
+
+class ResultSink
+{
+public:
+  typedef std::function<void(const std::string&, const std::string&, const std::string&)>
+      RowWriter;
+
+  ~ResultSink();
+
+  /**
+   * Buffer content for fileName until the next Commit.
+   */
+  void Append(const std::string& fileName, const std::string& content);
+
+  /**
+   * Set a header written in front of the rows when fileName is still empty
+   * at commit time, e.g. the schema of a binary table.
+   */
+  void SetHeader(const std::string& fileName, const std::string& header);
+
+  /**
+   * Write the buffered content of every file, one write() per file, and
+   * forget the files.
+   *
+   * \return false if a file could not be opened or written.
+   */
+  bool Commit();
+
+  /**
+   * Hand the file name, header and buffered content of every file to writer
+   * instead of writing it, e.g. to forward it to another process.
+   */
+  void Drain(RowWriter writer);
+
+  /**
+   * Discard the buffered rows.
+   */
+  void Close();
+
+private:
+  struct File
+  {
+    std::string m_header;
+    std::string m_pending;
+  };
+
+  std::map<std::string, File> m_files;
+};
+
+#endif /* RESULT_SINK_H */
@@ -53,8 +53,41 @@
  #include "ns3/adr-component.h"
  #include "ns3/csv-reader.h"
  
+ #include "alloc-cache.h"
+ #include "coord-bundle.h"
+ #include "counting-scheduler.h"
+ #include "delay-histogram.h"
+ #include "device-registry.h"
+ #include "event-profiler.h"
+ #include "gateway-search.h"
+ #include "kmeans.h"
+ #include "link-budget.h"
+ #include "lora-tables.h"
+ #include "multi-stream-sender.h"
+ #include "outcome-tracer.h"
+ #include "packet-ledger.h"
+ #include "pcc-priority.h"
+ #include "phase-timer.h"
+ #include "radio-energy-account.h"
+ #include "result-row.h"
+ #include "result-sink.h"
+ #include "scenario-policy.h"
+ #include "self-test.h"
+ #include "sequential-stop.h"
+ #include "sweep-driver.h"
+ #include "time-series-metrics.h"
+ #include "uplink-aggregator.h"
+ #include "warmup-fork.h"
+ 
  #include <algorithm>
+ #include <chrono>
  #include <ctime>
+ #include <filesystem>
+ #include <fstream>
+ #include <iomanip>
+ #include <map>
+ #include <sstream>
+ #include <type_traits>
  
  using namespace ns3;
  using namespace lorawan;
@@ -66,6 +99,8 @@
  int nGateways = 1;                  //!< Number of gateway nodes to create
  double radiusMeters = 7500;         //!< Radius (m) of the deployment
  double simulationTimeSeconds = 24 * 60 * 60; //!< Scenario duration (s) in simulated time
+ double pathLossExponent = 3.76; //!< Log-distance exponent (previously 3.52, suburban)
+ double referenceLoss = 7.7; //!< Log-distance loss (dB) at 1 m
  
  // Channel model
  bool realisticChannelModel = true; //!< Whether to use a more realistic channel model with
@@ -83,50 +118,16 @@
  
  std::string txMode = "nack"; //!< [nack, ack]
  std::string adrType = "ns3::AdrComponent";
- std::string adrName = "adr"; //!< [adr, adrPlus]
+ std::string adrName = "adr"; //!< [adr, caadr, mbadr]
  std::string smFile = "";
  std::string gwFile = "";
  
  // Data Strucutures
- enum PktStatus
- {
-   SENT,
-   OK,
-   LOST,
-   EXPIRED
- };
- 
- struct PacketInfo
- {
-   int m_pktId;
-   int m_edId;
- 
-   double m_txTime;
-   double m_delay;
-   double m_cpsrDelay;
- 
-   PktStatus m_status;
- 
-   PacketInfo(int pktId, 
-              int edId, 
-              double txTime) : 
-              m_pktId(pktId), 
-              m_edId(edId), 
-              m_txTime(txTime)
-   {
-     m_delay = -1;
-     m_cpsrDelay = -1;
-     m_status = SENT;
-   }
- };
- std::map<int, PacketInfo> pktInfoMap;
+ PacketLedger ledger; //!< Uplinks sent in the current run, indexed by compact id
+ UplinkAggregator aggregator; //!< Gateway reports of the transmissions on air
  
- std::vector<uint64_t> expiredPkts;
- std::vector<uint64_t> interfPkts;
- std::vector<uint64_t> underPkts;
- std::vector<uint64_t> busyPkts;
- std::vector<uint64_t> noMorePkts;
- std::vector<uint64_t> okPkts;
+ OutcomeTracer outcomeTracer; //!< Per-packet outcome stream, off unless --outcomeTrace
+ bool outcomeTrace = false;
  
  int nSent = 0;
  int nRec = 0;
@@ -149,17 +150,93 @@
  int nNoMore = 0;
  int nExpired = 0;
  int nRun = 1;
+ std::string runs = ""; //!< "first:last" replications of the multi-run mode
+ std::string sweep = ""; //!< Sweep spec, see ParseSweepSpec
+ std::string coordsDir = "."; //!< Root of the <N>/<N>sms.csv and <N>/<k>gws.csv sets
+ int jobs = 0; //!< Worker processes of the sweep, 0 for one per core
+ std::string allocCache = ""; //!< Directory of the SF/TP allocation cache, "" to disable
+ std::string coordBundle = ""; //!< Coordinate bundle used instead of smFile/gwFile
+ std::string buildCoordBundle = ""; //!< Write the bundle of coordsDir to this file and exit
+ int density = 0; //!< SM set of the bundle, 0 for nDevices
+ int gwCount = 0; //!< Gateway layout of the bundle, 0 for nGateways
+ bool perfReport = false; //!< Whether to write the phase times, event rate and peak RSS
+ bool multiStream = false; //!< One MultiStreamSender per SM instead of a PoissonSender per app
+ bool analyticEnergy = false; //!< Integrate the radio energy from the PHY states, no energy source
+ RadioEnergyAccount energyAccount; //!< Radio energy of the current run, for analyticEnergy
+ double progressMinutes = 0; //!< Simulated minutes between two progress reports, 0 to disable
+ std::string progressFile = ""; //!< JSON-lines file the progress reports are appended to, "" for stderr
+ double warmupHours = 0; //!< Simulated hours before the measurement window, 0 to measure the whole run
+ std::string variants = ""; //!< Continuations forked at the end of the warm-up, see ParseVariants
+ std::vector<WarmupVariant> warmupVariants; //!< Parsed variants
+ double measureStartMs = 0; //!< Start of the measurement window, earlier uplinks are not counted
+ double warmupConsumption = 0; //!< Energy (J) of all the EDs during the warm-up
+ double ciRel = 0; //!< Stop --runs, or the runs of a --sweep group, once the 95% CI half-width of every main metric is below this fraction of its mean, 0 to run them all
+ int minRuns = 3; //!< Replications always run before ciRel may stop
+ double pdrTarget = 0; //!< End a run once its PDR (%) is clearly above or below this target, 0 to disable
+ double earlyStopSeconds = -1; //!< Time the current run was ended by pdrTarget, -1 if it ran to the end
+ std::vector<double> runMetrics; //!< pdr, imr_pdr, billing_pdr, delay and energy of the last run
+ const std::vector<std::string> runMetricNames = {"pdr", "imr_pdr", "billing_pdr", "delay", "energy"}; //!< Names of runMetrics
+ std::string gwSearch = ""; //!< "min:max" gateway counts searched for the smallest meeting searchPdr
+ bool gwSearchGallop = false; //!< Gallop from the lower end instead of bisecting the range
+ double searchPdr = 99; //!< PDR (%) both IMR and PCC must reach in the gateway search
+ double gwRangeMargin = -1; //!< Shadowing margin (dB) of the link-budget gateway range cutoff, negative to disable
+ bool kmeansGateways = false; //!< Place the gateways on the k-means centroids of the SM positions
+ int writeGwLayouts = 0; //!< Write the 1..k k-means layouts of the SM set to coordsDir and exit, 0 to run
+ bool overwriteGwLayouts = false; //!< Let --writeGwLayouts replace existing <k>gws.csv files
+ KMeans gwPlacement; //!< k-means layouts of the current SM set, kept across runs
+ double streamMinutes = 0; //!< Cadence (simulated min) of the interval rows and ledger retirement, 0 to disable
+ 
+ /// Cumulative counters at the previous interval row, see StreamInterval
+ struct IntervalTotals
+ {
+   int m_sent = 0;
+   int m_rec = 0;
+   int m_expired = 0;
+   int m_lost = 0;
+   double m_sumDelay = 0;
+   double m_energy = 0;
+ };
+ IntervalTotals lastInterval;
+ 
+ bool pccPriority = false; //!< Give PCC uplinks precedence over IMR ones at saturated gateways and on the gateway links
+ bool selfTest = false; //!< Run the self-checks of the support modules and exit
+ bool profile = false; //!< Whether to profile the callbacks and the simulated hours
+ EventProfiler profiler; //!< Callback costs and hour samples of the current run, for profile
+ 
+ //! Probes of the profiler, in the order of probeNames
+ enum Probe : uint32_t
+ {
+   PROBE_SENT,
+   PROBE_OK,
+   PROBE_INTERF,
+   PROBE_UNDER,
+   PROBE_NO_MORE,
+   PROBE_BUSY,
+   PROBE_REQ_TX,
+   PROBE_RUN, //!< Whole Simulator::Run
+ };
+ const std::vector<std::string> probeNames = {"sent", "ok", "interf", "under", "no_more",
+                                              "busy", "req_tx", "run"};
+ PhaseTimer phaseTimer; //!< Phases of the current run, for perfReport
+ uint64_t nEvents = 0; //!< Simulator events executed by the current run
  
  std::vector<int> sfDist(6, 0);
  std::string path = "./";
- std::string sfa = ""; //!< ["isfa", "rsfa", "drsfa", "drsfa+"]
+ std::string sfa = ""; //!< ["", "none", "isfa", "rsfa", "sftpa", "drsfa", "drsftpa", "asfa"]
+ 
+ // Parsed from sfa, txMode and adrName by ParsePolicies
+ SfaPolicy sfaPolicy = SfaPolicy::NONE;
+ TxMode txModePolicy = TxMode::NACK;
+ AdrFlavor adrFlavor = AdrFlavor::ADR;
  
- int nSentPerHour = 0;
- int nRecPerHour = 0;
  int payloadSize = 51;
  
- std::vector<double> pdrsPerHourVec;
+ TimeSeriesMetrics timeSeries; //!< Per-bucket/SF/app counters of the current run
+ double bucketMinutes = 0; //!< Width of the time series buckets, 0 to disable
+ 
  NodeContainer endDevices;
+ DeviceRegistry registry; //!< MAC/PHY/energy handles of the nodes of the current run
+ LinkBudget linkBudget; //!< ED x GW receive powers, the log-distance part survives across runs
  
  std::vector<int> interfPerSf(6, 0);
  std::vector<int> underPerSf(6, 0);
@@ -168,212 +245,380 @@
  std::vector<int> noMorePerSf(6, 0);
  
  std::vector<double> delayPerApp(2, 0.0); //!< { 0: 'IMR', 1: 'AN' }
+ // Loss causes per application, { 0: 'IMR', 1: 'AN' }
+ std::vector<int> interfPerApp(2, 0);
+ std::vector<int> underPerApp(2, 0);
+ std::vector<int> expPerApp(2, 0);
+ std::vector<int> busyPerApp(2, 0);
+ std::vector<int> noMorePerApp(2, 0);
+ DelayHistogram delayHist[2]; //!< First-reception delays, { 0: 'IMR', 1: 'AN' }
+ DelayHistogram cpsrHist[2]; //!< Delays until the ACK of confirmed uplinks, { 0: 'IMR', 1: 'AN' }
  
  int nImrSent = 0;
  int nPccSent = 0;
  int nImrRec = 0;
  int nPccRec = 0;
  
- double RxPowerToSNR(double transmissionPower, double bandwidth = 125e3, double NF = 6)
+ double RxPowerToSNR(double transmissionPower)
  {
-   return transmissionPower + 174 - 10 * log10(bandwidth) - NF;
+   return LoraTables::Snr(transmissionPower);
  }
  
- void Sent(Ptr<const Packet> pkt, uint32_t edId)
+ /**
+  * Consolidate the gateway reports of one transmission of an uplink and
+  * update the run metrics once for it.
+  */
+ template <SfaPolicy P>
+ void CloseUplink(uint32_t id)
  {
-   int pktId = (int) pkt->GetUid();
-   auto pktInfoIt = pktInfoMap.find(pktId);
-   if(pktInfoIt != pktInfoMap.end())
+   UplinkResult res = aggregator.Close(ledger.m_window[id]);
+   ledger.m_window[id] = UplinkAggregator::NONE;
+   if (ledger.m_txTime[id] < measureStartMs)
    {
-     nRetx++;
      return;
    }
  
-   double txTime = Simulator::Now().GetNanoSeconds() * 1e-6;
-   PacketInfo pktInfo(pktId, (int) edId, txTime);
-   pktInfo.m_status = SENT;
-   pktInfoMap.insert(std::make_pair(pktId, pktInfo));
- 
-   AppTag appTag;
-   pkt->PeekPacketTag(appTag);
+   uint8_t sf = res.m_nReports > 0 ? res.m_sf : ledger.m_sf[id];
+   int index = sf - 7;
  
-   if (appTag.GetMsgType() == IMR)
+   if (res.m_nReports > 0)
    {
-     nImrSent++;
+     sumPktsRssi += res.m_bestRxPower;
+     sumPktsSnr += res.m_bestSnr;
+     nTotalPkts++;
    }
-   else if (appTag.GetMsgType() == PCC)
+ 
+   PktOutcome outcome = res.m_cause;
+ 
+   if (!res.m_success)
    {
-     nPccSent++;
-   }
+     nLost++;
+     timeSeries.AddLost(Simulator::Now().GetNanoSeconds() * 1e-6, sf, ledger.m_appType[id]);
  
-   nSent++;
-   nSentPerHour++;
- }
+     uint8_t app = ledger.m_appType[id] < 2 ? ledger.m_appType[id] : 0;
+     switch (outcome)
+     {
+       case OUTCOME_INTERF:
+         nInterf++;
+         interfPerSf[index]++;
+         interfPerApp[app]++;
+         break;
+       case OUTCOME_NO_MORE:
+         nNoMore++;
+         noMorePerSf[index]++;
+         noMorePerApp[app]++;
+         break;
+       case OUTCOME_BUSY:
+         nBusy++;
+         busyPerSf[index]++;
+         busyPerApp[app]++;
+         break;
+       default:
+         nUnder++;
+         underPerSf[index]++;
+         underPerApp[app]++;
+         break;
+     }
  
- int GetEdId(Ptr<const Packet> pkt)
- {
-   int pktId = (int) pkt->GetUid();
-   auto pktInfoIt = pktInfoMap.find(pktId);
+     if constexpr (SfaTraits<P>::REACTIVE)
+     {
+       if (outcome == OUTCOME_INTERF)
+       {
+         EndDeviceLorawanMac* mac = registry.GetEndDevice(ledger.m_edId[id]).m_mac;
  
-   if(pktInfoIt == pktInfoMap.end())
-   {
-     return -1;
+         uint8_t dr = 12 - sf;
+         mac->SetDataRate(dr > 0 ? dr - 1 : 0);
+       }
+     }
    }
+   // Only the first successful transmission of a packet counts
+   else if (ledger.m_delay[id] == -1)
+   {
+     sumRssi += res.m_bestRxPower;
+     sumSnr += res.m_bestSnr;
  
-   return pktInfoIt->second.m_edId;
- }
+     double delay = res.m_rxTimeNs * 1e-6 - ledger.m_txTime[id];
+     ledger.m_delay[id] = delay;
+     sumDelay += delay;
  
- void ComputeLqi(Ptr<const Packet> pkt)
- {
-   LoraTag tag;
-   pkt->PeekPacketTag(tag);
+     uint8_t appType = ledger.m_appType[id];
+     // Late receptions are part of the tail, so they are recorded as well
+     if (appType < 2)
+     {
+       delayHist[appType].Record(delay);
+     }
  
-   sumPktsRssi += tag.GetReceivePower();
-   sumPktsSnr += RxPowerToSNR(tag.GetReceivePower());
-   nTotalPkts++;
- }
+     if (appType == IMR && delay <= imrDelay)
+     {
+       ledger.m_status[id] = OK;
  
- int GetIndexBasedOnSf(Ptr<const Packet> pkt)
- {
-   LoraTag tag;
-   pkt->PeekPacketTag(tag);
-   int index = (int) tag.GetSpreadingFactor() - 7;
-   return index;
+       nImrRec++;
+       nRec++;
+       timeSeries.AddRec(ledger.m_txTime[id], ledger.m_sf[id], appType, delay);
+ 
+       delayPerApp[0] += delay;
+     }
+     else if (appType == PCC && delay <= pccDelay)
+     {
+       ledger.m_status[id] = OK;
+ 
+       nPccRec++;
+       nRec++;
+       timeSeries.AddRec(ledger.m_txTime[id], ledger.m_sf[id], appType, delay);
+ 
+       delayPerApp[1] += delay;
+     }
+     else
+     {
+       ledger.m_status[id] = EXPIRED;
+       nExpired++;
+       timeSeries.AddExpired(ledger.m_txTime[id], ledger.m_sf[id], appType);
+ 
+       outcome = OUTCOME_EXPIRED;
+       expPerSf[index]++;
+       expPerApp[appType < 2 ? appType : 0]++;
+     }
+   }
+ 
+   if (outcomeTracer.IsEnabled())
+   {
+     outcomeTracer.Record(ledger.m_uid[id], Simulator::Now().GetNanoSeconds(), res.m_bestGwId,
+                          outcome, sf, ledger.m_appType[id]);
+   }
  }
  
- void Ok(Ptr<const Packet> pkt, uint32_t gwId)
+ /**
+  * Close the windows still waiting for gateway reports, e.g. at the end of
+  * the run.
+  */
+ template <SfaPolicy P>
+ void CloseAllUplinks()
  {
-   int pktId = (int) pkt->GetUid();
-   auto pktInfoIt = pktInfoMap.find(pktId);
-   if(pktInfoIt == pktInfoMap.end())
+   for (uint32_t id = 0; id < ledger.GetN(); id++)
    {
-     return;
+     if (ledger.m_window[id] != UplinkAggregator::NONE)
+     {
+       CloseUplink<P>(id);
+     }
    }
+ }
  
-   ComputeLqi(pkt);
- 
-   if (pktInfoIt->second.m_delay != -1)
+ template <SfaPolicy P>
+ void Sent(Ptr<const Packet> pkt, uint32_t edId)
+ {
+   ProfileScope scope(profiler, PROBE_SENT);
+   uint64_t uid = pkt->GetUid();
+   uint32_t id = ledger.Find(uid);
+   if(id != PacketLedger::NONE)
    {
+     if (ledger.m_txTime[id] >= measureStartMs)
+     {
+       nRetx++;
+     }
+ 
+     if (ledger.m_window[id] != UplinkAggregator::NONE)
+     {
+       CloseUplink<P>(id);
+     }
+     ledger.m_window[id] = aggregator.Open(id);
      return;
    }
  
-   LoraTag tag;
-   pkt->PeekPacketTag(tag);
- 
-   double rssi = tag.GetReceivePower();
-   double snr = RxPowerToSNR(rssi);  
- 
-   sumRssi += rssi;
-   sumSnr += snr;
-   
-   double delay = Simulator::Now().GetNanoSeconds() * 1e-6 - pktInfoIt->second.m_txTime;
-   pktInfoIt->second.m_delay = delay;
-   sumDelay += delay;
- 
    AppTag appTag;
    pkt->PeekPacketTag(appTag);
-   
-   if (appTag.GetMsgType() == IMR && delay <= imrDelay)
-   {
-     pktInfoIt->second.m_status = OK;
-     
-     nImrRec++;
-     nRec++;
-     nRecPerHour++;
  
-     okPkts.push_back(pkt->GetUid());
+   LoraTag tag;
+   pkt->PeekPacketTag(tag);
  
-     delayPerApp[0] += delay;
-   }
-   else if (appTag.GetMsgType() == PCC && delay <= pccDelay)
+   double txTime = Simulator::Now().GetNanoSeconds() * 1e-6;
+   id = ledger.Insert(uid, (int) edId, txTime, (uint8_t) appTag.GetMsgType(), tag.GetSpreadingFactor());
+   if (id != PacketLedger::NONE)
    {
-     pktInfoIt->second.m_status = OK;
-     
-     nPccRec++;
-     nRec++;
-     nRecPerHour++;
- 
-     okPkts.push_back(pkt->GetUid());
+     ledger.m_window[id] = aggregator.Open(id);
+   }
  
-     delayPerApp[1] += delay;
+   if (appTag.GetMsgType() == IMR)
+   {
+     nImrSent++;
    }
-   else 
+   else if (appTag.GetMsgType() == PCC)
    {
-     pktInfoIt->second.m_status = EXPIRED;
-     nExpired++;
- 
-     expiredPkts.push_back(pkt->GetUid());
- 
-     int index = GetIndexBasedOnSf(pkt);
-     expPerSf[index]++;
+     nPccSent++;
    }
+ 
+   nSent++;
+   // Receptions are booked in the bucket and SF of the first transmission,
+   // so that rec/sent of a cell is its PDR
+   timeSeries.AddSent(txTime, tag.GetSpreadingFactor(), (uint8_t) appTag.GetMsgType());
  }
  
- void Interf(Ptr<const Packet> pkt, uint32_t gwId)
+ /**
+  * Fields of one gateway reception event, decoded from the packet once and
+  * handed to every metric consumer of the event.
+  */
+ struct RxRecord
  {
-   nInterf++;
-   nLost++;
+   uint32_t m_id;      //!< Ledger id of the packet, PacketLedger::NONE if untracked
+   uint8_t m_sf;       //!< Spreading factor of this transmission
+   double m_rxPower;   //!< Receive power at the gateway (dBm)
+   double m_snr;       //!< SNR at the gateway (dB)
+ };
+ 
+ RxRecord DecodeRx(Ptr<const Packet> pkt)
+ {
+   RxRecord rec;
+   rec.m_id = ledger.Find(pkt->GetUid());
  
    LoraTag tag;
    pkt->PeekPacketTag(tag);
+   rec.m_sf = tag.GetSpreadingFactor();
+   rec.m_rxPower = tag.GetReceivePower();
+   rec.m_snr = RxPowerToSNR(rec.m_rxPower);
  
-   ComputeLqi(pkt);
- 
-   uint8_t sf = tag.GetSpreadingFactor();
-   interfPerSf[sf - 7]++;
+   return rec;
+ }
  
-   interfPkts.push_back(pkt->GetUid());
-   
-   if (sfa == "asfa")
+ /**
+  * Add the outcome reported by one gateway to the window of the uplink. The
+  * app type is cached in the ledger when the packet is first sent, so the
+  * copies seen by the other gateways never peek the AppTag.
+  */
+ template <SfaPolicy P>
+ void CollectRx(Ptr<const Packet> pkt, uint32_t gwId, PktOutcome outcome)
+ {
+   RxRecord rec = DecodeRx(pkt);
+   if (rec.m_id == PacketLedger::NONE || ledger.m_window[rec.m_id] == UplinkAggregator::NONE)
    {
-     int edId = GetEdId(pkt);
- 
-     Ptr<Node> node = endDevices.Get(edId);
-     Ptr<LoraNetDevice> dev = node->GetDevice(0)->GetObject<LoraNetDevice>();
-     Ptr<EndDeviceLorawanMac> mac = dev->GetMac()->GetObject<EndDeviceLorawanMac>();
+     return;
+   }
  
-     uint8_t dr = 12 - sf;
-     mac->SetDataRate(dr > 0 ? dr - 1 : 0);
+   if (aggregator.Add(ledger.m_window[rec.m_id], gwId, outcome, rec.m_sf, rec.m_rxPower,
+                      rec.m_snr, Simulator::Now().GetNanoSeconds()))
+   {
+     CloseUplink<P>(rec.m_id);
    }
  }
  
- void Under(Ptr<const Packet> pkt, uint32_t gwId)
+ template <SfaPolicy P>
+ void Ok(Ptr<const Packet> pkt, uint32_t gwId)
  {
-   nUnder++;
-   nLost++;
- 
-   ComputeLqi(pkt);
+   ProfileScope scope(profiler, PROBE_OK);
+   CollectRx<P>(pkt, gwId, OUTCOME_OK);
+ }
  
-   underPkts.push_back(pkt->GetUid());
+ template <SfaPolicy P>
+ void Interf(Ptr<const Packet> pkt, uint32_t gwId)
+ {
+   ProfileScope scope(profiler, PROBE_INTERF);
+   CollectRx<P>(pkt, gwId, OUTCOME_INTERF);
+ }
  
-   int index = GetIndexBasedOnSf(pkt);
-   underPerSf[index]++;
+ template <SfaPolicy P>
+ void Under(Ptr<const Packet> pkt, uint32_t gwId)
+ {
+   ProfileScope scope(profiler, PROBE_UNDER);
+   CollectRx<P>(pkt, gwId, OUTCOME_UNDER);
  }
  
+ template <SfaPolicy P>
  void NoMore(Ptr<const Packet> pkt, uint32_t gwId)
  {
-   nNoMore++;
-   nLost++;
- 
-   ComputeLqi(pkt);
- 
-   noMorePkts.push_back(pkt->GetUid());
- 
-   int index = GetIndexBasedOnSf(pkt);
-   noMorePerSf[index]++;
+   ProfileScope scope(profiler, PROBE_NO_MORE);
+   CollectRx<P>(pkt, gwId, OUTCOME_NO_MORE);
  }
  
+ template <SfaPolicy P>
  void Busy(Ptr<const Packet> pkt, uint32_t gwId)
  {
-   nBusy++;
-   nLost++;
+   ProfileScope scope(profiler, PROBE_BUSY);
+   CollectRx<P>(pkt, gwId, OUTCOME_BUSY);
+ }
+ 
+ /**
+  * Connect the uplink trace callbacks, instantiated for the SFA policy P, to
+  * every gateway and end device of the registry.
+  */
+ template <SfaPolicy P>
+ void ConnectUplinkTraces()
+ {
+   for (uint32_t i = 0; i < registry.GetNGateways(); i++)
+   {
+     GatewayLoraPhy* phy = registry.GetGateway(i).m_phy;
+     phy->TraceConnectWithoutContext("ReceivedPacket", 
+                                     MakeCallback(&Ok<P>));
+     phy->TraceConnectWithoutContext("LostPacketBecauseInterference", 
+                                     MakeCallback(&Interf<P>));
+     phy->TraceConnectWithoutContext("LostPacketBecauseUnderSensitivity", 
+                                     MakeCallback(&Under<P>));
+     phy->TraceConnectWithoutContext("LostPacketBecauseNoMoreReceivers",
+                                     MakeCallback(&NoMore<P>));
+     phy->TraceConnectWithoutContext("NoReceptionBecauseTransmitting",
+                                     MakeCallback(&Busy<P>));
+   }
  
-   ComputeLqi(pkt);
+   for (uint32_t i = 0; i < registry.GetNEndDevices(); i++)
+   {
+     EndDeviceLoraPhy* phy = registry.GetEndDevice(i).m_phy;
+     phy->TraceConnectWithoutContext("StartSending", MakeCallback(&Sent<P>));
+   }
+ }
  
-   busyPkts.push_back(pkt->GetUid());
+ /**
+  * Call f with std::integral_constant<SfaPolicy, policy>, so that f can
+  * instantiate a template for the policy parsed at run time.
+  */
+ template <class F>
+ void DispatchSfa(SfaPolicy policy, F f)
+ {
+   switch (policy)
+   {
+     case SfaPolicy::NONE:
+       f(std::integral_constant<SfaPolicy, SfaPolicy::NONE>());
+       break;
+     case SfaPolicy::ISFA:
+       f(std::integral_constant<SfaPolicy, SfaPolicy::ISFA>());
+       break;
+     case SfaPolicy::RSFA:
+       f(std::integral_constant<SfaPolicy, SfaPolicy::RSFA>());
+       break;
+     case SfaPolicy::SFTPA:
+       f(std::integral_constant<SfaPolicy, SfaPolicy::SFTPA>());
+       break;
+     case SfaPolicy::DRSFA:
+       f(std::integral_constant<SfaPolicy, SfaPolicy::DRSFA>());
+       break;
+     case SfaPolicy::DRSFTPA:
+       f(std::integral_constant<SfaPolicy, SfaPolicy::DRSFTPA>());
+       break;
+     case SfaPolicy::ASFA:
+       f(std::integral_constant<SfaPolicy, SfaPolicy::ASFA>());
+       break;
+   }
+ }
  
-   int index = GetIndexBasedOnSf(pkt);
-   busyPerSf[index]++;
+ /**
+  * Parse sfa, txMode and adrName into their policy enums.
+  *
+  * \return false, after printing the offending value, if one is unknown.
+  */
+ bool ParsePolicies()
+ {
+   if (!ParseSfaPolicy(sfa, sfaPolicy))
+   {
+     std::cerr << "Unknown --sfa=" << sfa << std::endl;
+     return false;
+   }
+   if (!ParseTxMode(txMode, txModePolicy))
+   {
+     std::cerr << "Unknown --txMode=" << txMode << ", expected nack or ack" << std::endl;
+     return false;
+   }
+   if (adrEnabled && !ParseAdrFlavor(adrName, adrFlavor))
+   {
+     std::cerr << "Unknown --adrName=" << adrName << ", expected adr, caadr or mbadr" << std::endl;
+     return false;
+   }
+   return true;
  }
  
  std::string MakeFileName(std::string name, std::string extension = "csv") 
@@ -383,35 +628,74 @@
    return fileName;
  }
  
+ ResultSink resultSink; //!< Result rows of the current run, committed once per run
+ std::string resultFormat = "csv"; //!< [csv, bin, both]
+ 
  void WriteFile(std::string fileName, std::string content) 
  {
-   std::ofstream file(fileName, std::ios::out | std::ios::app);
+   resultSink.Append(fileName, content);
+ }
+ 
+ /**
+  * Write one result row as CSV and/or as a binary record, depending on
+  * --resultFormat.
+  */
+ void WriteRow(std::string name, const ResultRow& row)
+ {
+   if (resultFormat != "bin")
+   {
+     WriteFile(MakeFileName(name), row.ToCsv());
+   }
+ 
+   if (resultFormat != "csv")
+   {
+     std::string fileName = MakeFileName(name, "bin");
+     resultSink.SetHeader(fileName, row.Schema());
+     resultSink.Append(fileName, row.ToBinary());
+   }
+ }
  
-   if (file.is_open())
+ /**
+  * Commit the rows of the finished run. Sweep workers hand them to the
+  * single writer of the parent instead.
+  */
+ void CommitResults()
+ {
+   if (SweepDriver::IsWorker())
    {
-     file << content;
-     file.close();
+     resultSink.Drain(&SweepDriver::SendRow);
+     return;
    }
+ 
+   resultSink.Commit();
  }
  
- void CalcEnergyConsumption(NodeContainer endDevices) 
+ void CalcEnergyConsumption() 
  {
    //std::ostringstream oss;
  
    consumption = 0;
-   for (uint32_t i = 0; i < endDevices.GetN(); i++)
+   if (energyAccount.IsEnabled())
+   {
+     double now = Simulator::Now().GetSeconds();
+     for (uint32_t i = 0; i < registry.GetNEndDevices(); i++)
+     {
+       consumption += energyAccount.GetTotalEnergy(i, now);
+     }
+   }
+   else
    {
-     Ptr<Node> node = endDevices.Get(i);
-     if (auto esc = node->GetObject<EnergySourceContainer>())
+     for (uint32_t i = 0; i < registry.GetNEndDevices(); i++)
      {
-       auto demc = esc->Get(0)->FindDeviceEnergyModels("ns3::LoraRadioEnergyModel");
-       if (demc.GetN())
+       if (auto model = registry.GetEndDevice(i).m_energy)
        {
-         //oss << demc.Get(0)->GetTotalEnergyConsumption() << ",";
-         consumption += demc.Get(0)->GetTotalEnergyConsumption();
+         //oss << model->GetTotalEnergyConsumption() << ",";
+         consumption += model->GetTotalEnergyConsumption();
        }
      }
    }
+   // Only the measurement window counts
+   consumption -= warmupConsumption;
  
    //oss << nRun << std::endl;
    //WriteFile(MakeFileName("energy"), oss.str());
@@ -420,19 +704,15 @@
  
  void PrintSFAndTP()
  {
-   // SF7, SF8, SF9, SF10, SF11, SF12, TP2, TP4, TP6, TP8, TP10, TP12, TP14, nRun
-   std::ostringstream oss;
+   // SF7, SF8, SF9, SF10, SF11, SF12, TP1, ..., TP14, nRun
+   ResultRow row;
  
    //std::vector<int> tpDist(7, 0);
    std::vector<int> tpDist(14, 0);
  
    for (int i = 0; i < nDevices; i++)
    {
-     Ptr<Node> node = endDevices.Get(i);
-     Ptr<NetDevice> netDevice = node->GetDevice(0);
-     Ptr<LoraNetDevice> loraNetDevice = DynamicCast<LoraNetDevice>(netDevice);
-     Ptr<ClassAEndDeviceLorawanMac> mac =
-         DynamicCast<ClassAEndDeviceLorawanMac>(loraNetDevice->GetMac());
+     EndDeviceLorawanMac* mac = registry.GetEndDevice(i).m_mac;
  
      sfDist[5 - (int) mac->GetDataRate()]++;
  
@@ -447,28 +727,34 @@
  
    for (size_t i = 0; i < sfDist.size(); i++)
    {
-     oss << (1.0 * sfDist[i] / nDevices * 100) << ",";
-     //std::cout << sfDist[i] << " | ";
+     row.AddDouble("sf" + std::to_string(i + 7), 1.0 * sfDist[i] / nDevices * 100);
    }
-   //std::cout << std::endl;
    for (size_t i = 0; i < tpDist.size(); i++)
    {
-     oss << (1.0 * tpDist[i] / nDevices * 100) << ",";
+     row.AddDouble("tp" + std::to_string(i + 1), 1.0 * tpDist[i] / nDevices * 100);
    }
-   oss << nRun << std::endl;
+   row.AddInt("nRun", nRun);
  
-   WriteFile(MakeFileName("sf_tp"), oss.str());
-   oss.clear();
-   
-   tpDist.clear();
-   sfDist.clear();
+   WriteRow("sf_tp", row);
+ }
+ 
+ /**
+  * Add the p50, p95, p99 and p99.9 delays (ms) of hist as <prefix>_p50, ...
+  */
+ void AddPercentiles(ResultRow& row, std::string prefix, const DelayHistogram& hist)
+ {
+   row.AddDouble(prefix + "_p50", hist.Quantile(0.5));
+   row.AddDouble(prefix + "_p95", hist.Quantile(0.95));
+   row.AddDouble(prefix + "_p99", hist.Quantile(0.99));
+   row.AddDouble(prefix + "_p999", hist.Quantile(0.999));
  }
  
  void PrintMainData()
  {
    // sent,rec,pdr,imr_sent,imr_rec,imr_pdr,billing_sent,billing_rec
-   // billing_pdr,delay,rssi,snr,energy,tput,ee1,ee2,ee3,ee4,nRun
-   std::ostringstream oss;
+   // billing_pdr,delay,rssi,snr,energy,tput,ee1,ee2,ee3,ee4,...,
+   // imr_p50,imr_p95,imr_p99,imr_p999,an_p50,...,nRun
+   ResultRow row;
  
    double pdr = ((nSent > 0 ? 1.0 * nRec / nSent : 0.0) * 100);
    double imrPdr = ((nImrSent > 0 ? 1.0 * nImrRec / nImrSent : 0.0) * 100);
@@ -479,7 +765,8 @@
    double avgSnr = (nRec > 0 ? sumSnr / nRec : 0.0);
    
    double energyCons = consumption / nDevices;
-   double tput = (nRec * payloadSize * 8) / (simulationTimeSeconds);
+   double endSeconds = earlyStopSeconds >= 0 ? earlyStopSeconds : simulationTimeSeconds;
+   double tput = (nRec * payloadSize * 8) / (endSeconds - measureStartMs / 1000);
    double ee1 = (nRec * payloadSize * 8) / consumption;
    double ee2 = (nRec * payloadSize * 8) / energyCons;
    double ee3 = tput / energyCons;
@@ -487,28 +774,61 @@
  
    double avgPktsRssi = (nTotalPkts > 0 ? sumPktsRssi / nTotalPkts : 0.0);
    double avgPktsSnr = (nTotalPkts > 0 ? sumPktsSnr / nTotalPkts : 0.0);
+ 
+   runMetrics = {pdr, imrPdr, billingPdr, avgDelay, energyCons};
    
+   row.AddInt("sent", nSent);
+   row.AddInt("rec", nRec);
+   row.AddDouble("pdr", pdr);
+   row.AddInt("imr_sent", nImrSent);
+   row.AddInt("imr_rec", nImrRec);
+   row.AddDouble("imr_pdr", imrPdr);
+   row.AddInt("an_sent", nPccSent);
+   row.AddInt("an_rec", nPccRec);
+   row.AddDouble("an_pdr", billingPdr);
+   row.AddDouble("delay", avgDelay);
+ 
    double cpsr = 0;
-   if (txMode == "ack")
+   if (txModePolicy == TxMode::ACK)
    {
      cpsr = (nRec > 0 ? (1.0 * nRecAck / nRec) * 100 : 0.0);
-     oss << nSent << "," << nRec << "," << pdr << "," << nImrSent << "," << nImrRec << "," << imrPdr 
-       << "," << nPccSent << "," << nPccRec << "," << billingPdr << "," << avgDelay << "," 
-       << avgRssi << "," << avgSnr << "," << energyCons << "," << tput << "," << ee1 << "," << ee2 
-       << "," << ee3 << "," << ee4 << "," << nReqTx << "," << nRecAck << "," << cpsr << "," 
-       << avgPktsRssi << "," << avgPktsSnr << "," << nRun << std::endl;
    }
-   else if (txMode == "nack")
+   else if (txModePolicy == TxMode::NACK)
+   {
+     row.AddDouble("imr_delay", delayPerApp[0] / nImrRec);
+     row.AddDouble("pcc_delay", delayPerApp[1] / nPccRec);
+   }
+ 
+   row.AddDouble("rssi", avgRssi);
+   row.AddDouble("snr", avgSnr);
+   row.AddDouble("energy", energyCons);
+   row.AddDouble("tput", tput);
+   row.AddDouble("ee1", ee1);
+   row.AddDouble("ee2", ee2);
+   row.AddDouble("ee3", ee3);
+   row.AddDouble("ee4", ee4);
+ 
+   if (txModePolicy == TxMode::ACK)
+   {
+     row.AddInt("req_tx", nReqTx);
+     row.AddInt("rec_ack", nRecAck);
+     row.AddDouble("cpsr", cpsr);
+   }
+ 
+   row.AddDouble("rssi_pkts", avgPktsRssi);
+   row.AddDouble("snr_pkts", avgPktsSnr);
+ 
+   AddPercentiles(row, "imr", delayHist[0]);
+   AddPercentiles(row, "an", delayHist[1]);
+   if (txModePolicy == TxMode::ACK)
    {
-     oss << nSent << "," << nRec << "," << pdr << "," << nImrSent << "," << nImrRec << "," << imrPdr 
-         << "," << nPccSent << "," << nPccRec << "," << billingPdr << "," << avgDelay << "," 
-         << (delayPerApp[0] / nImrRec) << "," << (delayPerApp[1] / nPccRec) << "," << avgRssi << "," 
-         << avgSnr << "," << energyCons << "," << tput << "," << ee1 << "," << ee2 << "," 
-         << ee3 << "," << ee4 << "," << avgPktsRssi << "," << avgPktsSnr << "," << nRun << std::endl;
+     AddPercentiles(row, "cpsr_imr", cpsrHist[0]);
+     AddPercentiles(row, "cpsr_an", cpsrHist[1]);
    }
  
-   WriteFile(MakeFileName("data"), oss.str());
-   oss.clear();
+   row.AddInt("nRun", nRun);
+ 
+   WriteRow("data", row);
  
    /*std::cout << "nSent = " << nSent << std::endl;
    std::cout << "nRec = " << nRec << std::endl;
@@ -545,33 +865,33 @@
    // interf_rate, under_rate, nomore_rate, busy_rate, exp_rate
    // interf_sf7, interf_sf8, interf_sf9, interf_sf10, interf_sf11, interf_sf12
  
-   std::ostringstream oss;
-   
-   oss << nInterf << ",";
-   oss << nUnder << ",";
-   oss << nNoMore << ",";
-   oss << nBusy << ",";
-   oss << nExpired << ",";
-   oss << nLost << ",";
+   ResultRow row;
+ 
+   row.AddInt("n_interf", nInterf);
+   row.AddInt("n_under", nUnder);
+   row.AddInt("n_no_more", nNoMore);
+   row.AddInt("n_busy", nBusy);
+   row.AddInt("n_exp", nExpired);
+   row.AddInt("n_lost", nLost);
  
-   oss << (nLost > 0 ? (1.0 * nInterf / nLost) * 100 : 0.0) << ",";
-   oss << (nLost > 0 ? (1.0 * nUnder / nLost) * 100  : 0.0) << ",";
-   oss << (nLost > 0 ? (1.0 * nNoMore / nLost) * 100 : 0.0) << ",";
-   oss << (nLost > 0 ? (1.0 * nBusy / nLost) * 100 : 0.0) << ",";  
-   oss << (nLost > 0 ? (1.0 * nExpired / nLost) * 100 : 0.0) << ",";  
+   row.AddDouble("interf_rate", nLost > 0 ? (1.0 * nInterf / nLost) * 100 : 0.0);
+   row.AddDouble("under_rate", nLost > 0 ? (1.0 * nUnder / nLost) * 100  : 0.0);
+   row.AddDouble("nomore_rate", nLost > 0 ? (1.0 * nNoMore / nLost) * 100 : 0.0);
+   row.AddDouble("busy_rate", nLost > 0 ? (1.0 * nBusy / nLost) * 100 : 0.0);
+   row.AddDouble("exp_rate", nLost > 0 ? (1.0 * nExpired / nLost) * 100 : 0.0);
  
-   if (nInterf > 0)
+   // The CSV line only carries the per-SF split when there was interference,
+   // the binary record always has the six columns
+   for (size_t i = 0; i < interfPerSf.size(); i++)
    {
-     for (auto interf: interfPerSf)
-     {
-       oss << ((1.0 * interf / nInterf) * 100) << ",";
-     }
+     row.AddDouble("interf_sf" + std::to_string(i + 7),
+                   nInterf > 0 ? (1.0 * interfPerSf[i] / nInterf) * 100 : 0.0,
+                   nInterf > 0);
    }
  
-   oss << nRun << std::endl;
+   row.AddInt("nRun", nRun);
  
-   WriteFile(MakeFileName("losses"), oss.str());
-   oss.clear();
+   WriteRow("losses", row);
  
    /*for (auto exp: expPerSf)
    {
@@ -580,153 +900,538 @@
    std::cout << std::endl;*/
  }
  
- void PrintPdrsPerHour()
+ /**
+  * Write one row per application (0: IMR, 1: AN) with its deliveries, loss
+  * causes and delays, to compare the classes under load (classes table).
+  */
+ void PrintClasses()
  {
-   std::ostringstream oss;
-   for (size_t i = 0; i < pdrsPerHourVec.size(); i++)
+   const int sent[2] = {nImrSent, nPccSent};
+   const int rec[2] = {nImrRec, nPccRec};
+ 
+   for (int app = 0; app < 2; app++)
    {
-     oss << i+1 << "," << pdrsPerHourVec[i] << std::endl;
+     ResultRow row;
+     row.AddInt("app", app);
+     row.AddInt("sent", sent[app]);
+     row.AddInt("rec", rec[app]);
+     row.AddInt("exp", expPerApp[app]);
+     row.AddInt("interf", interfPerApp[app]);
+     row.AddInt("under", underPerApp[app]);
+     row.AddInt("no_more", noMorePerApp[app]);
+     row.AddInt("busy", busyPerApp[app]);
+     row.AddDouble("pdr", sent[app] > 0 ? (1.0 * rec[app] / sent[app]) * 100 : 0.0);
+     row.AddDouble("avg_delay", rec[app] > 0 ? delayPerApp[app] / rec[app] : 0.0);
+     row.AddDouble("p50_delay", delayHist[app].Quantile(0.5));
+     row.AddDouble("p99_delay", delayHist[app].Quantile(0.99));
+     row.AddInt("nRun", nRun);
+     WriteRow("classes", row);
    }
- 
-   WriteFile(MakeFileName("pdrs_" + std::to_string(nRun)), oss.str());
-   oss.clear();
  }
  
- void PrintData()
+ /**
+  * Write the time series of the run: the PDR of every bucket (pdrs_<nRun>)
+  * and the counters of every non-empty bucket x SF x app cell
+  * (timeseries_<nRun>).
+  */
+ void PrintTimeSeries()
  {
-   PrintSep();
-   
-   std::cout << "** nRun = " << nRun << " **" << std::endl;
-   PrintMainData();
-   PrintSFAndTP();
-   //PrintPdrsPerHour();
-   PrintLoss();
+   if (!timeSeries.IsEnabled())
+   {
+     return;
+   }
  
-   /*std::cout << std::endl;
-   std::cout << "Ok: " << unsigned(okPkts.size()) << std::endl;
-   std::cout << "Expired: " << unsigned(expiredPkts.size()) << std::endl;
-   std::cout << "Under: " << unsigned(underPkts.size()) << std::endl;
-   std::cout << "Interf: " << unsigned(interfPkts.size()) << std::endl;
-   std::cout << "No More: " << unsigned(noMorePkts.size()) << std::endl;
-   std::cout << "Busy: " << unsigned(busyPkts.size()) << std::endl;
-   PrintSep();
+   std::string suffix = "_" + std::to_string(nRun);
+   double bucketSeconds = timeSeries.GetBucketMs() / 1000;
  
-   for (auto ok: okPkts)
+   for (uint32_t b = 0; b < timeSeries.GetNBuckets(); b++)
    {
-     for (size_t i = 0; i < expiredPkts.size(); i++)
-     {
-       if (ok == expiredPkts[i])
-       {
-         expiredPkts.erase(expiredPkts.begin() + i);
-       }
-     }
+     TimeSeriesCell total = timeSeries.Get(b, TimeSeriesMetrics::ALL, TimeSeriesMetrics::ALL);
  
-     for (size_t i = 0; i < underPkts.size(); i++)
-     {
-       if (ok == underPkts[i])
-       {
-         underPkts.erase(underPkts.begin() + i);
-         
-       }
-     }
+     ResultRow pdrRow;
+     pdrRow.AddInt("bucket", b + 1);
+     pdrRow.AddDouble("pdr", total.m_sent > 0 ? (1.0 * total.m_rec / total.m_sent) * 100 : 0.0);
+     WriteRow("pdrs" + suffix, pdrRow);
  
-     for (size_t i = 0; i < interfPkts.size(); i++)
+     for (uint32_t sfIndex = 0; sfIndex < TimeSeriesMetrics::N_SF; sfIndex++)
      {
-       if (ok == interfPkts[i])
+       for (uint32_t app = 0; app < TimeSeriesMetrics::N_APP; app++)
        {
-         interfPkts.erase(interfPkts.begin() + i);
-         
+         TimeSeriesCell cell = timeSeries.Get(b, sfIndex, app);
+         if (cell.m_sent == 0 && cell.m_lost == 0)
+         {
+           continue;
+         }
+ 
+         ResultRow row;
+         row.AddInt("bucket", b + 1);
+         row.AddDouble("start", b * bucketSeconds);
+         row.AddInt("sf", sfIndex + 7);
+         row.AddInt("app", app);
+         row.AddInt("sent", cell.m_sent);
+         row.AddInt("rec", cell.m_rec);
+         row.AddInt("exp", cell.m_expired);
+         row.AddInt("lost", cell.m_lost);
+         row.AddDouble("pdr", cell.m_sent > 0 ? (1.0 * cell.m_rec / cell.m_sent) * 100 : 0.0);
+         row.AddDouble("delay", cell.m_rec > 0 ? cell.m_sumDelay / cell.m_rec : 0.0);
+         row.AddInt("nRun", nRun);
+         WriteRow("timeseries" + suffix, row);
        }
      }
+   }
+ }
  
-     for (size_t i = 0; i < noMorePkts.size(); i++)
-     {
-       if (ok == noMorePkts[i])
-       {
-         noMorePkts.erase(noMorePkts.begin() + i);
-         
-       }
-     }
+ /**
+  * Write the wall-clock time of each phase (s), the event rate of the
+  * simulation and the peak RSS (KiB) of the process so far.
+  */
+ void PrintPerf()
+ {
+   double runSeconds = phaseTimer.Get("run");
  
-     for (size_t i = 0; i < busyPkts.size(); i++)
-     {
-       if (ok == busyPkts[i])
-       {
-         busyPkts.erase(busyPkts.begin() + i);
-         
-       }
-     }
+   ResultRow row;
+   row.AddInt("devices", nDevices);
+   row.AddInt("gateways", nGateways);
+   for (const char* phase : {"setup", "alloc", "install", "run", "report"})
+   {
+     row.AddDouble(phase, phaseTimer.Get(phase));
    }
+   row.AddInt("events", nEvents);
+   row.AddDouble("events_per_s", runSeconds > 0 ? nEvents / runSeconds : 0.0);
+   row.AddInt("peak_rss_kb", PhaseTimer::PeakRssKb());
+   row.AddInt("nRun", nRun);
  
-   std::cout << "Sent: " << nSent << std::endl;
-   std::cout << "Ok: " << unsigned(okPkts.size()) << std::endl;
-   std::cout << "Ok: " << nRec << std::endl;
-   std::cout << "Expired: " << unsigned(expiredPkts.size()) << std::endl;
-   std::cout << "Under: " << unsigned(underPkts.size()) << std::endl;
-   std::cout << "Interf: " << unsigned(interfPkts.size()) << std::endl;
-   std::cout << "NoMore: " << unsigned(noMorePkts.size()) << std::endl;
-   std::cout << "Busy: " << unsigned(busyPkts.size()) << std::endl;*/
+   WriteRow("perf", row);
  
-   PrintSep();
+   std::cout << "perf: setup " << phaseTimer.Get("setup") << " s, alloc "
+             << phaseTimer.Get("alloc") << " s, install " << phaseTimer.Get("install")
+             << " s, run " << runSeconds << " s (" << nEvents << " events), peak RSS "
+             << PhaseTimer::PeakRssKb() / 1024 << " MiB" << std::endl;
  }
  
- void ClearData()
+ /**
+  * Append one JSON line with the progress of the run (simulated/wall time
+  * ratio, event rate since the previous report, RSS, cumulative sent and
+  * received uplinks, estimated wall time left) to progressFile, or stderr,
+  * and schedule the next report progressMinutes of simulated time later.
+  */
+ void ReportProgress(std::chrono::steady_clock::time_point start, double lastWall, uint64_t lastEvents)
  {
-   pktInfoMap.clear();
-   sfDist.clear();
-   pdrsPerHourVec.clear();
-   interfPerSf.clear();
- 
-   expiredPkts.clear();
-   interfPkts.clear();
-   underPkts.clear();
-   busyPkts.clear();
-   noMorePkts.clear();
-   okPkts.clear();
- 
-   underPerSf.clear();
-   expPerSf.clear();
-   noMorePerSf.clear();
-   busyPerSf.clear();
-   delayPerApp.clear();
+   double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+   double simSeconds = Simulator::Now().GetSeconds();
+   double endSeconds = simulationTimeSeconds + 3600;
+   uint64_t events = Simulator::GetEventCount();
+ 
+   double ratio = wall > 0 ? simSeconds / wall : 0.0;
+   double eventsPerSecond = wall > lastWall ? (events - lastEvents) / (wall - lastWall) : 0.0;
+ 
+   std::ostringstream line;
+   line << "{\"nRun\":" << nRun << ",\"devices\":" << nDevices << ",\"gateways\":" << nGateways
+        << ",\"sfa\":\"" << sfa << "\",\"sim_s\":" << simSeconds << ",\"end_s\":" << endSeconds
+        << ",\"wall_s\":" << wall << ",\"ratio\":" << ratio << ",\"events_per_s\":" << eventsPerSecond
+        << ",\"rss_kb\":" << PhaseTimer::CurrentRssKb() << ",\"sent\":" << nSent << ",\"rec\":" << nRec
+        << ",\"eta_s\":" << (ratio > 0 ? (endSeconds - simSeconds) / ratio : -1) << "}\n";
+ 
+   if (progressFile.empty())
+   {
+     std::cerr << line.str() << std::flush;
+   }
+   else
+   {
+     // One write per line, so that the lines of sweep workers do not interleave
+     std::ofstream out(progressFile, std::ios::app);
+     out << line.str() << std::flush;
+   }
+ 
+   Simulator::Schedule(Minutes(progressMinutes), &ReportProgress, start, wall, events);
  }
  
- void RequiredTransmissionsCallback(uint8_t reqTx,
-                                   bool success,
+ /**
+  * Streaming mode: retire the ledger entries older than the hour every
+  * uplink gets to conclude (the same hour the run is extended by), write
+  * the metrics of the last streamMinutes as one row of the intervals table
+  * and the rows buffered so far, and schedule the next interval. The
+  * memory of the run then stays bounded by the traffic of one hour plus
+  * one interval, whatever simulationTimeSeconds.
+  */
+ void StreamInterval(uint32_t interval)
+ {
+   double nowMs = Simulator::Now().GetNanoSeconds() * 1e-6;
+   uint32_t retired = ledger.Retire(nowMs - 3600 * 1000);
+   aggregator.Rebase(retired);
+ 
+   CalcEnergyConsumption();
+   int sent = nSent - lastInterval.m_sent;
+   int rec = nRec - lastInterval.m_rec;
+ 
+   ResultRow row;
+   row.AddInt("interval", interval);
+   row.AddDouble("end_h", nowMs / 3600000);
+   row.AddInt("sent", sent);
+   row.AddInt("rec", rec);
+   row.AddInt("exp", nExpired - lastInterval.m_expired);
+   row.AddInt("lost", nLost - lastInterval.m_lost);
+   row.AddDouble("pdr", sent > 0 ? (1.0 * rec / sent) * 100 : 0.0);
+   row.AddDouble("delay", rec > 0 ? (sumDelay - lastInterval.m_sumDelay) / rec : 0.0);
+   row.AddDouble("energy", (consumption - lastInterval.m_energy) / nDevices);
+   row.AddInt("ledger", ledger.GetN());
+   row.AddInt("rss_kb", PhaseTimer::CurrentRssKb());
+   row.AddInt("nRun", nRun);
+   WriteRow("intervals", row);
+   CommitResults();
+ 
+   lastInterval = {nSent, nRec, nExpired, nLost, sumDelay, consumption};
+   Simulator::Schedule(Minutes(streamMinutes), &StreamInterval, interval + 1);
+ }
+ 
+ /**
+  * Close the profile sample of the simulated hour that just ended and
+  * schedule the next one.
+  */
+ void ProfileHour(uint32_t hour, uint64_t events, std::chrono::steady_clock::time_point wall)
+ {
+   uint64_t eventsNow = Simulator::GetEventCount();
+   std::chrono::steady_clock::time_point wallNow = std::chrono::steady_clock::now();
+ 
+   HourSample sample;
+   sample.m_hour = hour;
+   sample.m_events = eventsNow - events;
+   sample.m_wallSeconds = std::chrono::duration<double>(wallNow - wall).count();
+   sample.m_queueDepth = CountingMapScheduler::GetDepth();
+   sample.m_maxQueueDepth = CountingMapScheduler::GetMaxDepth();
+   profiler.AddHour(sample);
+   CountingMapScheduler::ResetMaxDepth();
+ 
+   Simulator::Schedule(Hours(1), &ProfileHour, hour + 1, eventsNow, wallNow);
+ }
+ 
+ /**
+  * Write the calls, total cost, p50/p99 cost of one call and share of the
+  * run of every callback probe (profile table), and the events, wall time
+  * and queue depth of every simulated hour (profile_hours table). Whatever
+  * the run spends outside the callbacks is ns-3 core and the LoRa module,
+  * PHY interference included.
+  */
+ void PrintProfile()
+ {
+   double runCost = (double) profiler.GetCost(PROBE_RUN);
+   double callbackCost = 0;
+ 
+   ResultRow row;
+   for (uint32_t p = 0; p < PROBE_RUN; p++)
+   {
+     const std::string& name = profiler.GetName(p);
+     row.AddInt(name + "_calls", profiler.GetCount(p));
+     row.AddDouble(name + "_cost", profiler.GetCost(p));
+     row.AddDouble(name + "_p50", profiler.Quantile(p, 0.5));
+     row.AddDouble(name + "_p99", profiler.Quantile(p, 0.99));
+     row.AddDouble(name + "_share", runCost > 0 ? profiler.GetCost(p) / runCost : 0.0);
+     callbackCost += profiler.GetCost(p);
+   }
+   row.AddDouble("run_cost", runCost);
+   row.AddDouble("callbacks_share", runCost > 0 ? callbackCost / runCost : 0.0);
+   row.AddInt("nRun", nRun);
+   WriteRow("profile", row);
+ 
+   for (const HourSample& sample : profiler.GetHours())
+   {
+     ResultRow hourRow;
+     hourRow.AddInt("hour", sample.m_hour);
+     hourRow.AddInt("events", sample.m_events);
+     hourRow.AddDouble("wall_s", sample.m_wallSeconds);
+     hourRow.AddDouble("events_per_s", sample.m_wallSeconds > 0 ? sample.m_events / sample.m_wallSeconds : 0.0);
+     hourRow.AddInt("queue_depth", sample.m_queueDepth);
+     hourRow.AddInt("max_queue_depth", sample.m_maxQueueDepth);
+     hourRow.AddInt("nRun", nRun);
+     WriteRow("profile_hours", hourRow);
+   }
+ 
+   std::cout << "profile: callbacks " << callbackCost / 1e6 << " M" << EventProfiler::Unit()
+             << " of " << runCost / 1e6 << " M" << EventProfiler::Unit() << " ("
+             << (runCost > 0 ? 100 * callbackCost / runCost : 0.0) << "% of the run)" << std::endl;
+ }
+ 
+ void PrintData()
+ {
+   PrintSep();
+   
+   std::cout << "** nRun = " << nRun << " **" << std::endl;
+   PrintMainData();
+   PrintSFAndTP();
+   PrintLoss();
+   PrintClasses();
+   PrintTimeSeries();
+ 
+   PrintSep();
+ }
+ 
+ /**
+  * End the run once the 99% Wilson interval of the PDR measured so far lies
+  * entirely above or below pdrTarget, otherwise check again one simulated
+  * hour later. Uplinks still within their deadline count as not received,
+  * which biases the check towards "missed" by at most the deadline over an
+  * hour of traffic.
+  */
+ void CheckPdrTarget()
+ {
+   double lower;
+   double upper;
+   WilsonInterval(nRec, nSent, 2.576, lower, upper);
+   if (nSent > 0 && (lower * 100 > pdrTarget || upper * 100 < pdrTarget))
+   {
+     earlyStopSeconds = Simulator::Now().GetSeconds();
+     std::cout << "pdrTarget: run " << nRun << " " << (lower * 100 > pdrTarget ? "meets" : "misses")
+               << " " << pdrTarget << "% at " << Simulator::Now().GetHours() << " h (PDR in ["
+               << lower * 100 << ", " << upper * 100 << "])" << std::endl;
+     Simulator::Stop();
+     return;
+   }
+   Simulator::Schedule(Hours(1), &CheckPdrTarget);
+ }
+ 
+ /**
+  * Write the replications run, whether they converged, and the mean and
+  * 95% CI half-width of every main metric (ci table).
+  */
+ void PrintConvergence(const SequentialStop& stop, int runsDone, bool converged)
+ {
+   ResultRow row;
+   row.AddInt("runs", runsDone);
+   row.AddInt("converged", converged);
+   for (uint32_t m = 0; m < stop.GetNMetrics(); m++)
+   {
+     row.AddDouble(stop.GetName(m) + "_mean", stop.Get(m).GetMean());
+     row.AddDouble(stop.GetName(m) + "_ci", stop.Get(m).GetHalfWidth());
+   }
+   WriteRow("ci", row);
+   CommitResults();
+ 
+   std::cout << "ciRel: " << (converged ? "converged" : "not converged") << " after " << runsDone
+             << " runs" << std::endl;
+ }
+ 
+ /**
+  * Reset the run metrics, e.g. at the start of the measurement window.
+  */
+ void ResetCounters()
+ {
+   sfDist.assign(6, 0);
+   interfPerSf.assign(6, 0);
+   underPerSf.assign(6, 0);
+   expPerSf.assign(6, 0);
+   noMorePerSf.assign(6, 0);
+   busyPerSf.assign(6, 0);
+   delayPerApp.assign(2, 0.0);
+   interfPerApp.assign(2, 0);
+   underPerApp.assign(2, 0);
+   expPerApp.assign(2, 0);
+   busyPerApp.assign(2, 0);
+   noMorePerApp.assign(2, 0);
+   for (int i = 0; i < 2; i++)
+   {
+     delayHist[i].Clear();
+     cpsrHist[i].Clear();
+   }
+ 
+   nSent = 0;
+   nRec = 0;
+   nRetx = 0;
+   nReqTx = 0;
+   nRecAck = 0;
+ 
+   sumDelay = 0;
+   sumRssi = 0;
+   sumPktsRssi = 0;
+   sumSnr = 0;
+   sumPktsSnr = 0;
+   consumption = 0;
+ 
+   nTotalPkts = 0;
+   nLost = 0;
+   nInterf = 0;
+   nUnder = 0;
+   nBusy = 0;
+   nNoMore = 0;
+   nExpired = 0;
+ 
+   nImrSent = 0;
+   nPccSent = 0;
+   nImrRec = 0;
+   nPccRec = 0;
+ 
+   lastInterval = IntervalTotals();
+ }
+ 
+ /**
+  * Reset every per-run counter and container, so that the next replication
+  * of the same process starts from a clean state.
+  */
+ void ClearData()
+ {
+   ledger.Clear();
+   aggregator.Clear();
+   phaseTimer.Clear();
+   nEvents = 0;
+   timeSeries.Clear();
+   endDevices = NodeContainer();
+   registry.Clear();
+   energyAccount.Clear();
+   profiler.Clear();
+   measureStartMs = 0;
+   warmupConsumption = 0;
+   earlyStopSeconds = -1;
+ 
+   ResetCounters();
+ }
+ 
+ /**
+  * Apply the settings of a continuation to the end devices of the registry.
+  * The values were checked by CheckVariants.
+  */
+ void ApplyVariant(const WarmupVariant& variant)
+ {
+   for (const auto& setting : variant.m_settings)
+   {
+     if (setting.first == "txMode")
+     {
+       ParseTxMode(setting.second, txModePolicy);
+     }
+ 
+     for (uint32_t i = 0; i < registry.GetNEndDevices(); i++)
+     {
+       EndDeviceLorawanMac* mac = registry.GetEndDevice(i).m_mac;
+       if (setting.first == "txMode")
+       {
+         mac->SetMType(txModePolicy == TxMode::ACK ? LorawanMacHeader::CONFIRMED_DATA_UP
+                                                   : LorawanMacHeader::UNCONFIRMED_DATA_UP);
+       }
+       else
+       {
+         mac->SetAttribute("DRControl", BooleanValue(setting.second == "1"));
+       }
+     }
+   }
+ }
+ 
+ /**
+  * \return false, after printing the offending setting, if a value of
+  *         warmupVariants is invalid.
+  */
+ bool CheckVariants()
+ {
+   for (const WarmupVariant& variant : warmupVariants)
+   {
+     for (const auto& setting : variant.m_settings)
+     {
+       TxMode mode;
+       bool valid = setting.first == "txMode" ? ParseTxMode(setting.second, mode)
+                                              : (setting.second == "0" || setting.second == "1");
+       if (!valid)
+       {
+         std::cerr << "Invalid --variants: " << variant.m_label << ": " << setting.first << "="
+                   << setting.second << std::endl;
+         return false;
+       }
+     }
+   }
+   return true;
+ }
+ 
+ /**
+  * End of the warm-up: write the DR/TP of every ED (snapshot table) and the
+  * warm-up counters (warmup table), fork the continuations, apply the
+  * variant of this process and restart the metrics for the measurement
+  * window.
+  */
+ void EndWarmup()
+ {
+   std::string suffix = "_" + std::to_string(nRun);
+   for (uint32_t i = 0; i < registry.GetNEndDevices(); i++)
+   {
+     EndDeviceLorawanMac* mac = registry.GetEndDevice(i).m_mac;
+     ResultRow row;
+     row.AddInt("ed", i);
+     row.AddInt("dr", mac->GetDataRate());
+     row.AddInt("tp", (int) mac->GetTransmissionPower());
+     WriteRow("snapshot" + suffix, row);
+   }
+ 
+   CalcEnergyConsumption();
+   warmupConsumption = consumption;
+ 
+   ResultRow row;
+   row.AddDouble("hours", warmupHours);
+   row.AddInt("sent", nSent);
+   row.AddInt("rec", nRec);
+   row.AddInt("lost", nLost);
+   row.AddInt("retx", nRetx);
+   row.AddDouble("energy", warmupConsumption / nDevices);
+   row.AddInt("nRun", nRun);
+   WriteRow("warmup", row);
+ 
+   // Nothing written before the fork may be committed twice
+   CommitResults();
+ 
+   if (!warmupVariants.empty())
+   {
+     uint32_t v = WarmupFork::Fork(warmupVariants.size());
+     if (WarmupFork::IsContinuation())
+     {
+       resultSink.Close();
+     }
+ 
+     const WarmupVariant& variant = warmupVariants[v];
+     ApplyVariant(variant);
+     path = path + "/" + variant.m_label;
+     std::filesystem::create_directories(path);
+     std::cout << "warmup: variant " << variant.m_label << " from "
+               << Simulator::Now().GetHours() << " h" << std::endl;
+   }
+ 
+   ResetCounters();
+   measureStartMs = Simulator::Now().GetNanoSeconds() * 1e-6;
+ }
+ 
+ void OnEndDeviceState(uint32_t edId, EndDeviceLoraPhy::State /* oldState */, EndDeviceLoraPhy::State newState)
+ {
+   double txPowerDbm = 0;
+   if (newState == EndDeviceLoraPhy::TX)
+   {
+     txPowerDbm = registry.GetEndDevice(edId).m_mac->GetTransmissionPower();
+   }
+   energyAccount.ChangeState(edId, Simulator::Now().GetSeconds(), newState, txPowerDbm);
+ }
+ 
+ void RequiredTransmissionsCallback(uint8_t reqTx,
+                                   bool success,
                                    Time firstAttempt,
                                    Ptr<Packet> packet)
  {
+   ProfileScope scope(profiler, PROBE_REQ_TX);
    if (!packet)
    {
      return;
    }
    
-   int pktId = (int) packet->GetUid();
-   auto pktInfoIt = pktInfoMap.find(pktId);
-   if(pktInfoIt == pktInfoMap.end())
+   uint32_t id = ledger.Find(packet->GetUid());
+   if(id == PacketLedger::NONE || ledger.m_txTime[id] < measureStartMs)
    {
      return;
    }
  
-   if (success && pktInfoIt->second.m_cpsrDelay == -1)
+   if (success && ledger.m_cpsrDelay[id] == -1)
    {
-     pktInfoIt->second.m_cpsrDelay = Simulator::Now().GetNanoSeconds() * 1e-6
+     ledger.m_cpsrDelay[id] = Simulator::Now().GetNanoSeconds() * 1e-6
                                        - firstAttempt.GetNanoSeconds() * 1e-6;              
      
      nRecAck++;
      nReqTx += reqTx;
-   }
- }
  
- void CalcPdrsPerHour()
- {
-   double pdr = (nSentPerHour > 0 ? (1.0 * nRecPerHour / nSentPerHour) * 100 : 0.0);
-   pdrsPerHourVec.push_back(pdr <= 100 ? pdr : 100);
- 
-   nSentPerHour = 0;
-   nRecPerHour = 0;
- 
-   Simulator::Schedule(Hours(1.0), &CalcPdrsPerHour);
+     if (ledger.m_appType[id] < 2)
+     {
+       cpsrHist[ledger.m_appType[id]].Record(ledger.m_cpsrDelay[id]);
+     }
+   }
  }
  
  /**
@@ -753,13 +1458,21 @@
      std::cout << oldTxPower << " dBm -> " << newTxPower << " dBm" << std::endl;
  }
  
- void PositionNodes(NodeContainer nodes, std::string filePath, double z)
+ std::map<std::string, std::vector<Vector>> coordCache; //!< Parsed coordinate files, kept across runs
+ 
+ /**
+  * \return The coordinates of filePath, parsed on first use only.
+  */
+ const std::vector<Vector>& LoadCoords(std::string filePath)
  {
-   CsvReader csv(filePath);
+   auto it = coordCache.find(filePath);
+   if (it != coordCache.end())
+   {
+     return it->second;
+   }
  
-   MobilityHelper mob;
-   mob.SetPositionAllocator("ns3::ConstantPositionMobilityModel");
-   Ptr<ListPositionAllocator> alloc = CreateObject<ListPositionAllocator>();
+   std::vector<Vector>& coords = coordCache[filePath];
+   CsvReader csv(filePath);
  
    while (csv.FetchNextRow ())
    {
@@ -771,81 +1484,416 @@
      double x, y;
      csv.GetValue(0, x);
      csv.GetValue(1, y);
-     alloc->Add(Vector3D(x, y, z));
+     coords.push_back(Vector(x, y, 0));
+   }
+ 
+   return coords;
+ }
+ 
+ CoordBundle coords; //!< Mapped --coordBundle, shared with the sweep workers
+ 
+ /**
+  * Check that the bundle has the SM set of density and the layout of
+  * gwCount gateways, printing the missing one.
+  */
+ bool HasCoordSets(uint32_t density, uint32_t gwCount)
+ {
+   uint32_t n;
+   if (!coords.Find(COORDS_SM, density, 0, n))
+   {
+     std::cerr << coordBundle << " has no SM set for density " << density << std::endl;
+     return false;
+   }
+   if (!coords.Find(COORDS_GW, density, gwCount, n))
+   {
+     std::cerr << coordBundle << " has no " << gwCount << "-gateway layout for density "
+               << density << std::endl;
+     return false;
+   }
+   return true;
+ }
+ 
+ /**
+  * Place nodes on a set of the coordinate bundle, straight from the mapped
+  * file.
+  */
+ void PositionNodes(NodeContainer nodes, CoordSetKind kind, uint32_t k, double z)
+ {
+   uint32_t n;
+   const double* xy = coords.Find(kind, density > 0 ? density : nDevices, k, n);
+   NS_ABORT_MSG_IF(!xy, "Coordinate set missing from " << coordBundle);
+ 
+   MobilityHelper mob;
+   mob.SetPositionAllocator("ns3::ConstantPositionMobilityModel");
+   Ptr<ListPositionAllocator> alloc = CreateObject<ListPositionAllocator>();
+ 
+   for (uint32_t i = 0; i < n; i++)
+   {
+     alloc->Add(Vector3D(xy[2 * i], xy[2 * i + 1], z));
    }
  
    mob.SetPositionAllocator(alloc);
    mob.Install(nodes);
  }
  
- void CalcDataPerHour()
+ void PositionNodes(NodeContainer nodes, std::string filePath, double z)
  {
+   MobilityHelper mob;
+   mob.SetPositionAllocator("ns3::ConstantPositionMobilityModel");
+   Ptr<ListPositionAllocator> alloc = CreateObject<ListPositionAllocator>();
+ 
+   for (const Vector& coord : LoadCoords(filePath))
+   {
+     alloc->Add(Vector3D(coord.x, coord.y, z));
+   }
+ 
+   mob.SetPositionAllocator(alloc);
+   mob.Install(nodes);
  }
-
- int
- main(int argc, char* argv[])
+ 
+ /**
+  * Place the gateways on the k-means centroids of the end device positions.
+  * The layouts of an SM set are kept, so runs over the same set only
+  * cluster once.
+  */
+ void PositionGatewaysKMeans(NodeContainer gateways, NodeContainer endDevices, double z)
  {
-     CommandLine cmd(__FILE__);
-     cmd.AddValue("nDevices", "Number of end devices to include in the simulation", nDevices);
-     cmd.AddValue("nGateways", "Number of gateways to include in the simulation", nGateways);
+   std::vector<double> x;
+   std::vector<double> y;
+   for (uint32_t i = 0; i < endDevices.GetN(); i++)
+   {
+     Vector pos = endDevices.Get(i)->GetObject<MobilityModel>()->GetPosition();
+     x.push_back(pos.x);
+     y.push_back(pos.y);
+   }
+   gwPlacement.SetPoints(x, y);
+   const std::vector<double>& layout = gwPlacement.GetLayout(gateways.GetN());
  
-     cmd.AddValue("radius", "The radius (m) of the area to simulate", radiusMeters);
+   MobilityHelper mob;
+   mob.SetPositionAllocator("ns3::ConstantPositionMobilityModel");
+   Ptr<ListPositionAllocator> alloc = CreateObject<ListPositionAllocator>();
+   for (uint32_t k = 0; k < gateways.GetN(); k++)
+   {
+     alloc->Add(Vector3D(layout[2 * k], layout[2 * k + 1], z));
+   }
+   mob.SetPositionAllocator(alloc);
+   mob.Install(gateways);
+ }
  
-     cmd.AddValue("realisticChannel",
-                  "Whether to use a more realistic channel model",
-                  realisticChannelModel);
+ /**
+  * Write the k-means layouts 1..maxK of the SM set of nDevices (smFile, or
+  * coordsDir/<N>/<N>sms.csv) as coordsDir/<N>/<k>gws.csv, like coords.py.
+  * Existing layouts, such as the scikit-learn ones of the repository, are
+  * only replaced with overwriteGwLayouts.
+  */
+ int WriteGatewayLayouts(int maxK)
+ {
+   std::string dir = coordsDir + "/" + std::to_string(nDevices) + "/";
+   std::string sms = smFile != "" ? smFile : dir + std::to_string(nDevices) + "sms.csv";
+   if (!std::filesystem::exists(sms))
+   {
+     std::cerr << "--writeGwLayouts: cannot find " << sms << std::endl;
+     return 1;
+   }
+   for (int k = 1; k <= maxK && !overwriteGwLayouts; k++)
+   {
+     std::string file = dir + std::to_string(k) + "gws.csv";
+     if (std::filesystem::exists(file))
+     {
+       std::cerr << "--writeGwLayouts: " << file << " exists, set --overwriteGwLayouts=1 to replace it"
+                 << std::endl;
+       return 1;
+     }
+   }
  
-     cmd.AddValue("simulationTime", "The time (s) for which to simulate", simulationTimeSeconds);
-     cmd.AddValue("appPeriod",
-                  "The period in seconds to be used by periodically transmitting applications",
-                  appPeriodSeconds);
-     
-     cmd.AddValue("nRun", "Number of Running", nRun);
-     cmd.AddValue("path", "Path to Save Results", path);
+   std::vector<double> x;
+   std::vector<double> y;
+   for (const Vector& coord : LoadCoords(sms))
+   {
+     x.push_back(coord.x);
+     y.push_back(coord.y);
+   }
+   gwPlacement.SetPoints(x, y);
+ 
+   std::filesystem::create_directories(dir);
+   for (int k = 1; k <= maxK; k++)
+   {
+     const std::vector<double>& layout = gwPlacement.GetLayout(k);
+     std::string file = dir + std::to_string(k) + "gws.csv";
+     std::ofstream out(file);
+     out << std::setprecision(17);
+     for (int c = 0; c < k; c++)
+     {
+       out << layout[2 * c] << "," << layout[2 * c + 1] << "\n";
+     }
+     out.close();
+     if (!out)
+     {
+       std::cerr << "--writeGwLayouts: cannot write " << file << std::endl;
+       return 1;
+     }
+   }
+   std::cout << "Wrote " << maxK << " k-means layouts of " << sms << " to " << dir << std::endl;
+   return 0;
+ }
+ 
+ /**
+  * Fill the link-budget matrix for a 14 dBm uplink of every end device to
+  * every gateway. The shadowing is queried pair by pair in device-major
+  * order, like the allocators of the lorawan module query the channel, so
+  * the same seed draws the same shadowing map.
+  */
+ void BuildLinkBudget(NodeContainer endDevices, NodeContainer gateways,
+                      Ptr<PropagationLossModel> shadowing)
+ {
+   std::vector<Ptr<MobilityModel>> edMobility;
+   std::vector<Ptr<MobilityModel>> gwMobility;
+   std::vector<LinkPosition> edPositions;
+   std::vector<LinkPosition> gwPositions;
+ 
+   for (uint32_t i = 0; i < endDevices.GetN(); i++)
+   {
+     edMobility.push_back(endDevices.Get(i)->GetObject<MobilityModel>());
+     Vector pos = edMobility.back()->GetPosition();
+     edPositions.push_back({pos.x, pos.y, pos.z});
+   }
+   for (uint32_t i = 0; i < gateways.GetN(); i++)
+   {
+     gwMobility.push_back(gateways.Get(i)->GetObject<MobilityModel>());
+     Vector pos = gwMobility.back()->GetPosition();
+     gwPositions.push_back({pos.x, pos.y, pos.z});
+   }
+ 
+   linkBudget.SetPathLoss(pathLossExponent, 1, referenceLoss);
+   linkBudget.SetPositions(edPositions, gwPositions);
+   // Pairs beyond the SF12 range plus the margin draw no shadowing
+   linkBudget.SetMaxRange(gwRangeMargin >= 0 ? linkBudget.GetRange(14, LoraTables::GW_SENSITIVITY[5], gwRangeMargin) : 0);
+   linkBudget.Compute(14, [&](uint32_t edId, uint32_t gwId) {
+     return shadowing->CalcRxPower(0, edMobility[edId], gwMobility[gwId]);
+   });
+ }
+ 
+ /**
+  * Give every end device the fastest data rate that its best gateway can
+  * still decode, from the link-budget matrix (the rule of
+  * LorawanMacHelper::SetSpreadingFactorsUpBasedOnGWSens).
+  */
+ void AllocateBySensitivity()
+ {
+   for (uint32_t i = 0; i < linkBudget.GetNEndDevices(); i++)
+   {
+     double rxPower = linkBudget.GetBestRxPower(i);
+     uint8_t dr = 0; // Out of range: SF12
+     for (int k = 0; k < 6; k++)
+     {
+       if (rxPower > LoraTables::GW_SENSITIVITY[k])
+       {
+         dr = 5 - k;
+         break;
+       }
+     }
+     registry.GetEndDevice(i).m_mac->SetDataRate(dr);
+   }
+ }
+ 
+ /**
+  * Key of the current allocation: scheme, seed, channel model, ToAs,
+  * allocator parameters and every node position.
+  */
+ AllocKey MakeAllocKey(NodeContainer endDevices, NodeContainer gateways,
+                       const std::vector<double>& toas)
+ {
+   AllocKey key;
+   key.Add((int) sfaPolicy);
+   key.Add(RngSeedManager::GetSeed());
+   key.Add(RngSeedManager::GetRun());
+   key.Add(pathLossExponent);
+   key.Add(referenceLoss);
+   key.Add(toas.data(), toas.size() * sizeof(double));
+   if (gwRangeMargin >= 0)
+   {
+     key.Add(gwRangeMargin);
+   }
+ 
+   // Parameters passed to the LorawanMacHelper allocators below
+   key.Add(600.0);
+   key.Add(0.99);
+   key.Add(3);
+ 
+   for (NodeContainer* nodes : {&endDevices, &gateways})
+   {
+     uint32_t n = nodes->GetN();
+     key.Add(n);
+     for (uint32_t i = 0; i < n; i++)
+     {
+       Vector pos = nodes->Get(i)->GetObject<MobilityModel>()->GetPosition();
+       key.Add(pos.x);
+       key.Add(pos.y);
+       key.Add(pos.z);
+     }
+   }
+   return key;
+ }
+ 
+ /**
+  * Apply the cached allocation of key to the end devices of the registry.
+  *
+  * \return false if the cache has no entry for key.
+  */
+ bool LoadCachedAllocation(const AllocKey& key)
+ {
+   std::vector<AllocEntry> entries;
+   if (!LoadAllocation(allocCache, key, registry.GetNEndDevices(), entries))
+   {
+     return false;
+   }
+ 
+   for (uint32_t i = 0; i < entries.size(); i++)
+   {
+     EndDeviceLorawanMac* mac = registry.GetEndDevice(i).m_mac;
+     mac->SetDataRate(entries[i].m_dataRate);
+     mac->SetTransmissionPower(entries[i].m_txPower);
+   }
+   return true;
+ }
+ 
+ /**
+  * Draw the shadowing of every end device to every gateway pair in
+  * device-major order, as the allocators do before they decide, so that a
+  * run served from the cache sees the same shadowing map as the run that
+  * computed the allocation.
+  */
+ void ReplayShadowing(NodeContainer endDevices, NodeContainer gateways,
+                      Ptr<PropagationLossModel> shadowing)
+ {
+   for (uint32_t i = 0; i < endDevices.GetN(); i++)
+   {
+     Ptr<MobilityModel> edMobility = endDevices.Get(i)->GetObject<MobilityModel>();
+     for (uint32_t j = 0; j < gateways.GetN(); j++)
+     {
+       shadowing->CalcRxPower(0, edMobility, gateways.Get(j)->GetObject<MobilityModel>());
+     }
+   }
+ }
+ 
+ /**
+  * Store the allocation the end devices of the registry got under key.
+  */
+ void SaveCachedAllocation(const AllocKey& key)
+ {
+   std::vector<AllocEntry> entries(registry.GetNEndDevices());
+   for (uint32_t i = 0; i < entries.size(); i++)
+   {
+     EndDeviceLorawanMac* mac = registry.GetEndDevice(i).m_mac;
+     entries[i].m_dataRate = mac->GetDataRate();
+     entries[i].m_txPower = (uint8_t) mac->GetTransmissionPower();
+   }
+ 
+   std::filesystem::create_directories(allocCache);
+   if (!SaveAllocation(allocCache, key, entries))
+   {
+     std::cerr << "Cannot write the allocation cache in " << allocCache << std::endl;
+   }
+ }
  
-     cmd.AddValue("sfa", "Spreading Factor Allocation Scheme", sfa);
-     cmd.AddValue("payload", "Payload Size", payloadSize);
-     cmd.AddValue("txMode", "Transmissiom Mode: NACK or ACK", txMode);
-     
-     cmd.AddValue("adrEnabled", "Whether to enable Adaptive Data Rate (ADR)", adrEnabled);
-     cmd.AddValue("adrType", "ADR Type", adrType);
-     cmd.AddValue("adrName", "ADR Name", adrName);
+ /**
+  * Expected number of distinct uplinks sent in seconds, used to size the ledger.
+  */
+ uint32_t EstimateUplinks(double seconds)
+ {
+   double perDevice = seconds / appPeriodSeconds + seconds / appPeriodicSecondsPcc;
+   // Poisson arrivals: leave some headroom over the mean
+   return (uint32_t) (1.25 * perDevice * nDevices) + 1;
+ }
  
-     cmd.AddValue("smFile", "File with the SM coordinates", smFile);
-     cmd.AddValue("gwFile", "File with the GW coordinates", gwFile);
+ /**
+  * Parse a "first:last" replication range (both inclusive). A single
+  * number runs one replication.
+  */
+ bool ParseRuns(std::string range, int& first, int& last)
+ {
+   size_t sep = range.find(':');
+   try
+   {
+     first = std::stoi(range.substr(0, sep));
+     last = (sep == std::string::npos ? first : std::stoi(range.substr(sep + 1)));
+   }
+   catch (const std::exception&)
+   {
+     return false;
+   }
  
-     cmd.Parse(argc, argv);
+   return first <= last;
+ }
+
+ /**
+  * Build, run and report one replication of the scenario for the current
+  * nRun.
+  */
+ void
+ RunScenario()
+ {
+     // Continuations may change the policies, which hold for the whole series
+     TxMode runTxMode = txModePolicy;
+     phaseTimer.Begin("setup");
+ 
+     if (profile)
+     {
+       profiler.Setup(probeNames);
+       ObjectFactory schedulerFactory;
+       schedulerFactory.SetTypeId("ns3::CountingMapScheduler");
+       Simulator::SetScheduler(schedulerFactory);
+     }
  
      RngSeedManager::SetSeed(2);
      RngSeedManager::SetRun(nRun);
+     // Each replication, in-process or not, numbers its streams from zero, as a fresh --nRun process does
+     RngSeedManager::ResetNextStreamIndex();
+ 
+     // Streaming: the ledger holds one hour plus one interval of uplinks at most
+     ledger.Reserve(EstimateUplinks(streamMinutes > 0 ? std::min(simulationTimeSeconds, 3600 + streamMinutes * 60)
+                                                      : simulationTimeSeconds));
+     timeSeries.Setup((simulationTimeSeconds + 3600) * 1000, bucketMinutes * 60 * 1000);
+ 
+     if (outcomeTrace)
+     {
+       std::string traceFile = MakeFileName("outcomes_" + std::to_string(nRun), "bin");
+       bool opened = outcomeTracer.Open(traceFile, nRun);
+       NS_ABORT_MSG_IF(!opened, "Cannot create the outcome trace " << traceFile);
+     }
  
-     // Set ToAs
-     std::vector<double> toas = {0.112896, 0.205312, 0.369664, 0.698368, 1.47866, 2.62963};
+     // ToAs of a payloadSize uplink for SF7 .. SF12
+     std::vector<double> toas(6);
+     std::ostringstream toaList;
+     for (uint8_t sf = 7; sf <= 12; sf++)
+     {
+       toas[sf - 7] = LoraTables::TimeOnAir(sf, payloadSize);
+       toaList << (sf > 7 ? "," : "") << toas[sf - 7];
+     }
  
      if (adrEnabled)
      {
-       if (adrName == "adr")
-       {
-          Config::SetDefault("ns3::EndDeviceLorawanMac::DRControl", BooleanValue(true));
-          Config::SetDefault("ns3::AdrComponent::HistoryRange", IntegerValue(20));
-          Config::SetDefault("ns3::AdrComponent::MultiplePacketsCombiningMethod", 
-                             EnumValue(AdrComponent::MAXIMUM));
-       }
-       if (adrName == "caadr")
+       switch (adrFlavor)
        {
-          Config::SetDefault("ns3::EndDeviceLorawanMac::DRControl", BooleanValue(true));
-          Config::SetDefault("ns3::AdrComponent::HistoryRange", IntegerValue(20));
-          Config::SetDefault("ns3::AdrComponent::MultiplePacketsCombiningMethod", 
-                             EnumValue(AdrComponent::AVERAGE));
-          Config::SetDefault("ns3::CAADR::Interval", DoubleValue(600));
-          Config::SetDefault("ns3::CAADR::ToAs", 
-                             StringValue("0.112896,0.205312,0.369664,0.698368,1.47866,2.62963"));
+         case AdrFlavor::ADR:
+           Config::SetDefault("ns3::EndDeviceLorawanMac::DRControl", BooleanValue(true));
+           Config::SetDefault("ns3::AdrComponent::HistoryRange", IntegerValue(20));
+           Config::SetDefault("ns3::AdrComponent::MultiplePacketsCombiningMethod", 
+                              EnumValue(AdrComponent::MAXIMUM));
+           break;
+         case AdrFlavor::CAADR:
+           Config::SetDefault("ns3::EndDeviceLorawanMac::DRControl", BooleanValue(true));
+           Config::SetDefault("ns3::AdrComponent::HistoryRange", IntegerValue(20));
+           Config::SetDefault("ns3::AdrComponent::MultiplePacketsCombiningMethod", 
+                              EnumValue(AdrComponent::AVERAGE));
+           Config::SetDefault("ns3::CAADR::Interval", DoubleValue(600));
+           Config::SetDefault("ns3::CAADR::ToAs", StringValue(toaList.str()));
+           break;
+         case AdrFlavor::MBADR:
+           Config::SetDefault("ns3::EndDeviceLorawanMac::DRControl", BooleanValue(true));
+           Config::SetDefault("ns3::AdrComponent::HistoryRange", IntegerValue(5));
+           break;
        }
-       if (adrName == "mbadr")
-       {
-          Config::SetDefault("ns3::EndDeviceLorawanMac::DRControl", BooleanValue(true));
-          Config::SetDefault("ns3::AdrComponent::HistoryRange", IntegerValue(5));
-       }  
      }
  
      //Config::SetDefault("ns3::LinearLoraTxCurrentModel::Voltage", DoubleValue(3.7));
@@ -867,28 +1915,27 @@
      // Mobility
      MobilityHelper mobility;
  
-     if (smFile == "")
+     if (coords.IsOpen())
+     {
+       PositionNodes(endDevices, COORDS_SM, 0, 1.5);
+     }
+     else if (smFile == "")
      {
+       // Nodes at a certain height > 0, set by the allocator instead of a
+       // second pass over the mobility models
        mobility.SetPositionAllocator("ns3::UniformDiscPositionAllocator",
                                      "rho",
                                      DoubleValue(radiusMeters),
                                      "X",
                                      DoubleValue(0.0),
                                      "Y",
-                                     DoubleValue(0.0));
+                                     DoubleValue(0.0),
+                                     "Z",
+                                     DoubleValue(1.5));
        mobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
  
        // Assign a mobility model to each node
        mobility.Install(endDevices);
- 
-       // Make it so that nodes are at a certain height > 0
-       for (auto j = endDevices.Begin(); j != endDevices.End(); ++j)
-       {
-           Ptr<MobilityModel> mobility = (*j)->GetObject<MobilityModel>();
-           Vector position = mobility->GetPosition();
-           position.z = 1.5;
-           mobility->SetPosition(position);
-       }
      }
      else
      {
@@ -901,8 +1948,8 @@
  
      // Create the lora channel object
      Ptr<LogDistancePropagationLossModel> loss = CreateObject<LogDistancePropagationLossModel>();
-     loss->SetPathLossExponent(3.76); // Anterior: 3.52 (Suburban)
-     loss->SetReference(1, 7.7);
+     loss->SetPathLossExponent(pathLossExponent);
+     loss->SetReference(1, referenceLoss);
  
      // Create the correlated shadowing component
      Ptr<CorrelatedShadowingPropagationLossModel> shadowing =
@@ -958,6 +2005,7 @@
      phyHelper.SetDeviceType(LoraPhyHelper::ED);
      macHelper.SetDeviceType(LorawanMacHelper::ED_A);
      NetDeviceContainer endDevicesNetDevices = helper.Install(phyHelper, macHelper, endDevices);
+     registry.AddEndDevices(endDevices);
  
      // Now end devices are connected to the channel
  
@@ -968,7 +2016,17 @@
      // Create the gateway nodes (allocate them uniformly on the disc)
      NodeContainer gateways;
  
-     if (gwFile == "")
+     if (kmeansGateways)
+     {
+       gateways.Create(nGateways);
+       PositionGatewaysKMeans(gateways, endDevices, 30.0);
+     }
+     else if (coords.IsOpen())
+     {
+       gateways.Create(nGateways);
+       PositionNodes(gateways, COORDS_GW, gwCount > 0 ? gwCount : nGateways, 30.0);
+     }
+     else if (gwFile == "")
      {
        gateways.Create(1);
        Ptr<ListPositionAllocator> allocator = CreateObject<ListPositionAllocator>();
@@ -987,59 +2045,80 @@
      phyHelper.SetDeviceType(LoraPhyHelper::GW);
      macHelper.SetDeviceType(LorawanMacHelper::GW);
      helper.Install(phyHelper, macHelper, gateways);
+     if (pccPriority)
+     {
+       PriorityGatewayLoraPhy::Install(gateways, channel);
+     }
+     registry.AddGateways(gateways);
+     aggregator.SetGateways(gateways.GetN());
+     aggregator.Reserve(64);
  
  
      /**********************************************
       *  Set up the end device's spreading factor  *
       **********************************************/
-     if (sfa == "isfa")
-     {
-       LorawanMacHelper::SetSpreadingFactorsUpBasedOnGWSens(endDevices, gateways, channel);
-     } 
-     else if (sfa == "rsfa")
-     {
-       // LorawanMacHelper::RSFA(endDevices, gateways, channel, true);
-       LorawanMacHelper::RSFA1(endDevices, gateways, channel, 
-                               toas, true, 600, 0.99, 3);
-     }
-     else if (sfa == "sftpa")
+     phaseTimer.Begin("alloc");
+ 
+     // Allocations are deterministic for a scenario and seed, ASFA and NONE
+     // have nothing to store, and ISFA costs no more than the shadowing a hit
+     // must replay anyway
+     bool useAllocCache = allocCache != "" && sfaPolicy != SfaPolicy::NONE
+                          && sfaPolicy != SfaPolicy::ASFA && sfaPolicy != SfaPolicy::ISFA;
+     AllocKey allocKey;
+     if (useAllocCache)
      {
-        //std::cout << "Accessando SFTPA1\n";
-        LorawanMacHelper::SFTPA1(endDevices, gateways, channel, 
-                                 toas, 3, true, 600, 0.99);
+       allocKey = MakeAllocKey(endDevices, gateways, toas);
      }
-     else if (sfa == "drsfa")
+ 
+     if (useAllocCache && LoadCachedAllocation(allocKey))
      {
-        //std::cout << "DR-SFA\n";
-        std::vector<double> maxDelays((int) endDevices.GetN(), 1);
-        LorawanMacHelper::DRSFA1(endDevices, gateways, channel, toas,
-                                 maxDelays, nRun, true, 600, 0.99);
+       ReplayShadowing(endDevices, gateways, shadowing);
      }
-     else if (sfa == "drsftpa")
+     else
      {
-        //std::cout << "DR-SFA\n";
-        std::vector<double> maxDelays((int) endDevices.GetN(), 1);
-        LorawanMacHelper::DRSFTPA(endDevices, gateways, channel, toas,
-                                  maxDelays, nRun, true, 600, 0.99);
-     }
+       switch (sfaPolicy)
+       {
+         case SfaPolicy::ISFA:
+           BuildLinkBudget(endDevices, gateways, shadowing);
+           AllocateBySensitivity();
+           break;
+         case SfaPolicy::RSFA:
+           // LorawanMacHelper::RSFA(endDevices, gateways, channel, true);
+           LorawanMacHelper::RSFA1(endDevices, gateways, channel, 
+                                   toas, true, 600, 0.99, 3);
+           break;
+         case SfaPolicy::SFTPA:
+           LorawanMacHelper::SFTPA1(endDevices, gateways, channel, 
+                                    toas, 3, true, 600, 0.99);
+           break;
+         case SfaPolicy::DRSFA:
+         {
+           std::vector<double> maxDelays((int) endDevices.GetN(), 1);
+           LorawanMacHelper::DRSFA1(endDevices, gateways, channel, toas,
+                                    maxDelays, nRun, true, 600, 0.99);
+           break;
+         }
+         case SfaPolicy::DRSFTPA:
+         {
+           std::vector<double> maxDelays((int) endDevices.GetN(), 1);
+           LorawanMacHelper::DRSFTPA(endDevices, gateways, channel, toas,
+                                     maxDelays, nRun, true, 600, 0.99);
+           break;
+         }
+         case SfaPolicy::NONE:
+         case SfaPolicy::ASFA:
+           // ASFA starts from the MAC defaults and only reacts to interference
+           break;
+       }
  
-     for (uint32_t i = 0; i < gateways.GetN(); i++)
-     {
-       Ptr<Node> node = gateways.Get(i);
-       Ptr<LoraNetDevice> dev = node->GetDevice(0)->GetObject<LoraNetDevice>();
-       Ptr<GatewayLoraPhy> phy = dev->GetPhy()->GetObject<GatewayLoraPhy>();
-       phy->TraceConnectWithoutContext("ReceivedPacket", 
-                                       MakeCallback(&Ok));
-       phy->TraceConnectWithoutContext("LostPacketBecauseInterference", 
-                                       MakeCallback(&Interf));
-       phy->TraceConnectWithoutContext("LostPacketBecauseUnderSensitivity", 
-                                       MakeCallback(&Under));
-       phy->TraceConnectWithoutContext("LostPacketBecauseNoMoreReceivers",
-                                       MakeCallback(&NoMore));
-       phy->TraceConnectWithoutContext("NoReceptionBecauseTransmitting",
-                                       MakeCallback(&Busy));
+       if (useAllocCache)
+       {
+         SaveCachedAllocation(allocKey);
+       }
      }
+ 
      NS_LOG_DEBUG("Completed configuration");
+     phaseTimer.Begin("install");
  
      /*********************************************
       *  Install applications on the end devices  *
@@ -1063,10 +2142,9 @@
      for (uint32_t i = 0; i < endDevices.GetN(); i++)
      {
        Ptr<Node> node = endDevices.Get(i);
-       Ptr<LoraNetDevice> dev = node->GetDevice(0)->GetObject<LoraNetDevice>();
-       Ptr<EndDeviceLorawanMac> mac = dev->GetMac()->GetObject<EndDeviceLorawanMac>();
+       EndDeviceLorawanMac* mac = registry.GetEndDevice(i).m_mac;
        
-       if (txMode == "ack")
+       if (txModePolicy == TxMode::ACK)
        {
          mac->SetMType(LorawanMacHeader::CONFIRMED_DATA_UP);
        }
@@ -1074,6 +2152,19 @@
        mac->TraceConnectWithoutContext("RequiredTransmissions",
                                        MakeCallback(&RequiredTransmissionsCallback));
  
+       if (multiStream)
+       {
+         Ptr<MultiStreamSender> app = CreateObject<MultiStreamSender>();
+         app->AddStream(Seconds(appPeriodSeconds), IMR, payloadSize,
+                        Seconds(m_intervalProb->GetValue(0, appPeriodSeconds)));
+         app->AddStream(Seconds(appPeriodicSecondsPcc), PCC, payloadSize,
+                        Seconds(m_intervalProb->GetValue(0, appPeriodicSecondsPcc)));
+         app->SetStartTime(Seconds(0));
+         app->SetStopTime(appStopTime);
+         node->AddApplication(app);
+         continue;
+       }
+ 
        // IMR
        Ptr<PoissonSender> app = CreateObject<PoissonSender>();
        app->SetPacketSize(payloadSize);
@@ -1091,13 +2182,10 @@
        appPcc->SetStopTime(appStopTime);
        appPcc->SetMsgType(PCC);
        node->AddApplication(appPcc);
- 
-       Ptr<LoraPhy> phy = dev->GetPhy();
-       phy->TraceConnectWithoutContext(
-           "StartSending", MakeCallback (&Sent)
-       );
      }
  
+     DispatchSfa(sfaPolicy, [](auto policy) { ConnectUplinkTraces<decltype(policy)::value>(); });
+ 
      //Config::ConnectWithoutContext(
      //    "/NodeList/*/DeviceList/0/$ns3::LoraNetDevice/Mac/$ns3::EndDeviceLorawanMac/TxPower",
      //    MakeCallback(&OnTxPowerChange));
@@ -1116,6 +2204,10 @@
      PointToPointHelper p2p;
      p2p.SetDeviceAttribute("DataRate", StringValue("5Mbps"));
      p2p.SetChannelAttribute("Delay", StringValue("2ms"));
+     if (pccPriority)
+     {
+       p2p.SetQueue("ns3::PriorityPacketQueue<Packet>");
+     }
      // Store network server app registration details for later
      P2PGwRegistration_t gwRegistration;
      for (auto gw = gateways.Begin(); gw != gateways.End(); ++gw)
@@ -1144,49 +2236,110 @@
       ************************/
  
      NS_LOG_INFO("Installing energy model on end devices...");
-     BasicEnergySourceHelper basicSourceHelper;
-     LoraRadioEnergyModelHelper radioEnergyHelper;
- 
-     // configure energy source
-     basicSourceHelper.Set("BasicEnergySourceInitialEnergyJ", DoubleValue(10000)); // Energy in J
-     basicSourceHelper.Set("BasicEnergySupplyVoltageV", DoubleValue(3.3));
- 
-     radioEnergyHelper.Set("StandbyCurrentA", DoubleValue(0.0014));
-     radioEnergyHelper.Set("TxCurrentA", DoubleValue(0.028));
-     radioEnergyHelper.Set("SleepCurrentA", DoubleValue(0.0000015));
-     radioEnergyHelper.Set("RxCurrentA", DoubleValue(0.0112));
- 
-     radioEnergyHelper.SetTxCurrentModel("ns3::LinearLoraTxCurrentModel");
-     /*radioEnergyHelper.SetTxCurrentModel("ns3::ConstantLoraTxCurrentModel",
-                                         "TxCurrent",
-                                         DoubleValue(0.028));*/
- 
- 
-     // install source on EDs' nodes
-     EnergySourceContainer sources = basicSourceHelper.Install(endDevices);
-     
-     // install device model
-     DeviceEnergyModelContainer deviceModels =
-         radioEnergyHelper.Install(endDevicesNetDevices, sources);
+     RadioCurrents currents;
+     if (analyticEnergy)
+     {
+       energyAccount.Setup(endDevices.GetN(), currents, RadioEnergyAccount::SLEEP);
+       for (uint32_t i = 0; i < endDevices.GetN(); i++)
+       {
+         registry.GetEndDevice(i).m_phy->TraceConnectWithoutContext(
+             "EndDeviceState", MakeBoundCallback(&OnEndDeviceState, i));
+       }
+     }
+     else
+     {
+       BasicEnergySourceHelper basicSourceHelper;
+       LoraRadioEnergyModelHelper radioEnergyHelper;
+ 
+       // configure energy source
+       basicSourceHelper.Set("BasicEnergySourceInitialEnergyJ", DoubleValue(10000)); // Energy in J
+       basicSourceHelper.Set("BasicEnergySupplyVoltageV", DoubleValue(currents.m_voltageV));
+ 
+       radioEnergyHelper.Set("StandbyCurrentA", DoubleValue(currents.m_standbyA));
+       radioEnergyHelper.Set("TxCurrentA", DoubleValue(0.028));
+       radioEnergyHelper.Set("SleepCurrentA", DoubleValue(currents.m_sleepA));
+       radioEnergyHelper.Set("RxCurrentA", DoubleValue(currents.m_rxA));
+ 
+       radioEnergyHelper.SetTxCurrentModel("ns3::LinearLoraTxCurrentModel");
+       /*radioEnergyHelper.SetTxCurrentModel("ns3::ConstantLoraTxCurrentModel",
+                                           "TxCurrent",
+                                           DoubleValue(0.028));*/
+ 
+       // install source on EDs' nodes
+       EnergySourceContainer sources = basicSourceHelper.Install(endDevices);
+ 
+       // install device model
+       DeviceEnergyModelContainer deviceModels =
+           radioEnergyHelper.Install(endDevicesNetDevices, sources);
+       registry.SetEnergyModels(deviceModels);
+     }
  
      ////////////////
      // Simulation //
      ////////////////
  
      Simulator::Stop(appStopTime + Hours(1));
-     //Simulator::Schedule(Hours(1.0), &CalcDataPerHour);
  
      NS_LOG_INFO("Running simulation...");
-     Simulator::Run();
+     phaseTimer.Begin("run");
+     uint64_t eventsBefore = Simulator::GetEventCount();
+     std::string runPath = path;
+     if (warmupHours > 0)
+     {
+       Simulator::Schedule(Hours(warmupHours), &EndWarmup);
+     }
+     if (pdrTarget > 0)
+     {
+       Simulator::Schedule(Hours(warmupHours + 1), &CheckPdrTarget);
+     }
+     if (progressMinutes > 0)
+     {
+       Simulator::Schedule(Minutes(progressMinutes), &ReportProgress, std::chrono::steady_clock::now(),
+                           0.0, eventsBefore);
+     }
+     if (profile)
+     {
+       Simulator::Schedule(Hours(1), &ProfileHour, 1u, eventsBefore, std::chrono::steady_clock::now());
+     }
+     if (streamMinutes > 0)
+     {
+       Simulator::Schedule(Minutes(streamMinutes), &StreamInterval, 1u);
+     }
+     {
+       ProfileScope scope(profiler, PROBE_RUN);
+       Simulator::Run();
+     }
+     nEvents = Simulator::GetEventCount() - eventsBefore;
  
-     CalcEnergyConsumption(endDevices);
+     phaseTimer.Begin("report");
+     DispatchSfa(sfaPolicy, [](auto policy) { CloseAllUplinks<decltype(policy)::value>(); });
+     outcomeTracer.Close();
+     CalcEnergyConsumption();
      PrintData();
+     phaseTimer.End();
+ 
+     if (perfReport)
+     {
+       PrintPerf();
+     }
+     if (profile)
+     {
+       PrintProfile();
+     }
+     CommitResults();
  
      Simulator::Destroy();
  
      ClearData();
      toas.clear();
  
+     if (WarmupFork::Finish() > 0)
+     {
+       std::cerr << "warmup: some continuations of run " << nRun << " failed" << std::endl;
+     }
+     path = runPath;
+     txModePolicy = runTxMode;
+ 
      ///////////////////////////
      // Print results to file //
      ///////////////////////////
@@ -1194,7 +2347,374 @@
  
      /*LoraPacketTracker& tracker = helper.GetPacketTracker();
      std::cout << tracker.CountMacPacketsGlobally(Seconds(0), appStopTime + Hours(1)) << std::endl;*/
+ }
+ 
+ /**
+  * Run the replications firstRun..lastRun of the current cell back to back,
+  * stopping early once they converge with --ciRel.
+  *
+  * \return The mean of runMetrics over the replications that ran.
+  */
+ std::vector<double> RunReplications(int firstRun, int lastRun)
+ {
+   SequentialStop stop(runMetricNames, ciRel, minRuns);
+   bool converged = false;
+   int runsDone = 0;
+   for (nRun = firstRun; nRun <= lastRun && !converged; nRun++)
+   {
+     RunScenario();
+     runsDone++;
+ 
+     stop.Add(runMetrics);
+     converged = ciRel > 0 && stop.IsConverged();
+   }
+ 
+   if (ciRel > 0)
+   {
+     PrintConvergence(stop, runsDone, converged);
+   }
+ 
+   std::vector<double> means;
+   for (uint32_t m = 0; m < stop.GetNMetrics(); m++)
+   {
+     means.push_back(stop.Get(m).GetMean());
+   }
+   return means;
+ }
+ 
+ /**
+  * Find the smallest gateway layout of the --gwSearch range whose IMR and
+  * PCC PDRs (within their deadlines, averaged over the replications) both
+  * reach searchPdr. Each probed count runs like a --runs cell and keeps its
+  * usual <k>gw_* results; the probes and the threshold are written to
+  * <path>/gw_search.csv.
+  */
+ int RunGatewaySearch(int firstRun, int lastRun)
+ {
+   int minGateways;
+   int maxGateways;
+   if (!ParseRuns(gwSearch, minGateways, maxGateways) || minGateways < 1)
+   {
+     std::cerr << "Invalid --gwSearch=" << gwSearch << ", expected min:max" << std::endl;
+     return 1;
+   }
+ 
+   std::string dir = coordsDir + "/" + std::to_string(nDevices) + "/";
+   for (int k = minGateways; k <= maxGateways && !kmeansGateways; k++)
+   {
+     if (coords.IsOpen() ? !HasCoordSets(density > 0 ? density : nDevices, k)
+                         : !std::filesystem::exists(dir + std::to_string(k) + "gws.csv"))
+     {
+       std::cerr << "--gwSearch: no " << k << "-gateway layout for " << nDevices
+                 << " devices" << std::endl;
+       return 1;
+     }
+   }
+   if (!coords.IsOpen() && smFile == "")
+   {
+     smFile = dir + std::to_string(nDevices) + "sms.csv";
+   }
+ 
+   std::map<uint32_t, std::vector<double>> probed;
+   GatewaySearch search(minGateways, maxGateways, gwSearchGallop);
+   uint32_t found = search.Run([&](uint32_t k) {
+     nGateways = k;
+     gwCount = 0;
+     if (!coords.IsOpen())
+     {
+       gwFile = dir + std::to_string(k) + "gws.csv";
+     }
+ 
+     probed[k] = RunReplications(firstRun, lastRun);
+     bool pass = probed[k][1] >= searchPdr && probed[k][2] >= searchPdr;
+     std::cout << "gwSearch: " << k << " gateways, IMR " << probed[k][1] << "%, PCC "
+               << probed[k][2] << "% -> " << (pass ? "meets" : "misses") << " " << searchPdr
+               << "%" << std::endl;
+     return pass;
+   });
+ 
+   for (const auto& probe : search.GetProbes())
+   {
+     ResultRow row;
+     row.AddInt("devices", nDevices);
+     row.AddInt("gateways", probe.first);
+     row.AddDouble("imr_pdr", probed[probe.first][1]);
+     row.AddDouble("billing_pdr", probed[probe.first][2]);
+     row.AddInt("meets", probe.second);
+     row.AddInt("min_gateways", found);
+     WriteFile(path + "/gw_search.csv", row.ToCsv());
+   }
+   CommitResults();
+ 
+   std::cout << "gwSearch: " << nDevices << " devices need "
+             << (found > 0 ? std::to_string(found) : "more than " + std::to_string(maxGateways))
+             << " gateways (" << search.GetProbes().size() << " of "
+             << maxGateways - minGateways + 1 << " layouts run)" << std::endl;
+   return 0;
+ }
+ 
+ /**
+  * Result directory of a sweep cell, following the <path>/<sfa>/<N> layout
+  * of sbrc26.py.
+  */
+ std::string SweepCellPath(std::string root, const SweepCell& cell)
+ {
+   std::string scheme = cell.m_sfa != "" ? cell.m_sfa : (adrEnabled ? adrName : "none");
+   return root + "/" + scheme + "/" + std::to_string(cell.m_nDevices);
+ }
+ 
+ /**
+  * Run every cell of the --sweep spec on a pool of worker processes.
+  */
+ int RunSweep()
+ {
+   std::vector<SweepCell> cells;
+   std::string error;
+   if (!ParseSweepSpec(sweep, cells, error))
+   {
+     std::cerr << "Invalid --sweep: " << error << std::endl;
+     return 1;
+   }
+ 
+   for (const SweepCell& cell : cells)
+   {
+     if (coords.IsOpen() && !HasCoordSets(cell.m_nDevices, cell.m_nGateways))
+     {
+       return 1;
+     }
+ 
+     SfaPolicy policy;
+     if (!ParseSfaPolicy(cell.m_sfa, policy))
+     {
+       std::cerr << "Invalid --sweep: unknown sfa " << cell.m_sfa << std::endl;
+       return 1;
+     }
+   }
+ 
+   std::string root = path;
+   for (const SweepCell& cell : cells)
+   {
+     std::filesystem::create_directories(SweepCellPath(root, cell));
+   }
+ 
+   SweepDriver driver(jobs);
+   if (ciRel > 0)
+   {
+     // Each devices x gateways x sfa group stops its runs on convergence,
+     // its ci table goes next to its data
+     driver.SetStopRule(runMetricNames, ciRel, minRuns,
+                        [root](const SweepCell& cell, const SequentialStop& stop, bool converged) {
+                          nGateways = cell.m_nGateways;
+                          path = SweepCellPath(root, cell);
+                          PrintConvergence(stop, stop.Get(0).GetN(), converged);
+                        });
+   }
+   uint32_t nFailed = driver.Run(cells,
+                                 [root](const SweepCell& cell) {
+                                   nDevices = cell.m_nDevices;
+                                   nGateways = cell.m_nGateways;
+                                   sfa = cell.m_sfa;
+                                   ParseSfaPolicy(sfa, sfaPolicy);
+                                   nRun = cell.m_nRun;
+ 
+                                   density = 0;
+                                   gwCount = 0;
+                                   std::string dir = coordsDir + "/" + std::to_string(nDevices) + "/";
+                                   smFile = dir + std::to_string(nDevices) + "sms.csv";
+                                   gwFile = dir + std::to_string(nGateways) + "gws.csv";
+                                   path = SweepCellPath(root, cell);
+ 
+                                   // A worker runs many cells: none may inherit the streams of the cells it ran before
+                                   RngSeedManager::SetRun(nRun);
+                                   RngSeedManager::ResetNextStreamIndex();
+                                   RunScenario();
+                                   if (ciRel > 0)
+                                   {
+                                     SweepDriver::SendMetrics(runMetrics);
+                                   }
+                                 },
+                                 [](const std::string& fileName,
+                                    const std::string& header,
+                                    const std::string& content) {
+                                   if (header != "")
+                                   {
+                                     resultSink.SetHeader(fileName, header);
+                                   }
+                                   resultSink.Append(fileName, content);
+                                   resultSink.Commit();
+                                 });
+ 
+   std::cout << "Sweep finished: " << cells.size() - nFailed - driver.GetNSkipped() << "/"
+             << cells.size() << " cells completed";
+   if (driver.GetNSkipped() > 0)
+   {
+     std::cout << ", " << driver.GetNSkipped() << " skipped by --ciRel";
+   }
+   std::cout << std::endl;
+   return nFailed > 0 ? 1 : 0;
+ }
+ 
+ int
+ main(int argc, char* argv[])
+ {
+     CommandLine cmd(__FILE__);
+     cmd.AddValue("nDevices", "Number of end devices to include in the simulation", nDevices);
+     cmd.AddValue("nGateways", "Number of gateways to include in the simulation", nGateways);
+ 
+     cmd.AddValue("radius", "The radius (m) of the area to simulate", radiusMeters);
+ 
+     cmd.AddValue("realisticChannel",
+                  "Whether to use a more realistic channel model",
+                  realisticChannelModel);
+ 
+     cmd.AddValue("simulationTime", "The time (s) for which to simulate", simulationTimeSeconds);
+     cmd.AddValue("appPeriod",
+                  "The period in seconds to be used by periodically transmitting applications",
+                  appPeriodSeconds);
+     
+     cmd.AddValue("nRun", "Number of Running", nRun);
+     cmd.AddValue("path", "Path to Save Results", path);
+ 
+     cmd.AddValue("sfa", "Spreading Factor Allocation Scheme", sfa);
+     cmd.AddValue("payload", "Payload Size", payloadSize);
+     cmd.AddValue("txMode", "Transmissiom Mode: NACK or ACK", txMode);
+     
+     cmd.AddValue("adrEnabled", "Whether to enable Adaptive Data Rate (ADR)", adrEnabled);
+     cmd.AddValue("adrType", "ADR Type", adrType);
+     cmd.AddValue("adrName", "ADR Name", adrName);
+ 
+     cmd.AddValue("smFile", "File with the SM coordinates", smFile);
+     cmd.AddValue("gwFile", "File with the GW coordinates", gwFile);
+     cmd.AddValue("outcomeTrace", "Whether to write the per-packet outcome trace", outcomeTrace);
+     cmd.AddValue("runs", "Replications to run back to back in this process (first:last)", runs);
+     cmd.AddValue("sweep", "Sweep spec, e.g. devices=200,400;gateways=1:28;sfa=isfa;runs=1:10", sweep);
+     cmd.AddValue("coordsDir", "Directory with the <N>/<N>sms.csv and <N>/<k>gws.csv sets", coordsDir);
+     cmd.AddValue("bucketMinutes", "Width (min) of the time series buckets, 0 to disable", bucketMinutes);
+     cmd.AddValue("resultFormat", "Format of the result tables: csv, bin or both", resultFormat);
+     cmd.AddValue("allocCache", "Directory of the SF/TP allocation cache (empty: disabled)", allocCache);
+     cmd.AddValue("coordBundle", "Coordinate bundle to place the nodes from (see --buildCoordBundle)", coordBundle);
+     cmd.AddValue("density", "SM set of the coordinate bundle (0: nDevices)", density);
+     cmd.AddValue("gwCount", "Gateway layout of the coordinate bundle (0: nGateways)", gwCount);
+     cmd.AddValue("buildCoordBundle", "Write the coordinate bundle of coordsDir to this file and exit", buildCoordBundle);
+     cmd.AddValue("perfReport", "Whether to write the phase times, event rate and peak RSS (perf table)", perfReport);
+     cmd.AddValue("multiStream", "Whether to generate the IMR and PCC streams of a SM in one application", multiStream);
+     cmd.AddValue("analyticEnergy", "Whether to integrate the ED energy from the PHY states instead of installing energy sources", analyticEnergy);
+     cmd.AddValue("progressMinutes", "Simulated minutes between two JSON-lines progress reports, 0 to disable", progressMinutes);
+     cmd.AddValue("progressFile", "File the progress reports are appended to (empty: stderr)", progressFile);
+     cmd.AddValue("warmupHours", "Simulated hours before the measurement window (0: measure the whole run)", warmupHours);
+     cmd.AddValue("variants", "Continuations forked after the warm-up, e.g. base;ack:txMode=ack;noadr:adr=0", variants);
+     cmd.AddValue("ciRel", "Stop --runs, or the runs of each --sweep group, once every main metric's 95% CI half-width is below this fraction of its mean (0: run all)", ciRel);
+     cmd.AddValue("minRuns", "Replications always run before --ciRel may stop", minRuns);
+     cmd.AddValue("pdrTarget", "End a run once its PDR (%) is clearly above or below this target (0: disabled)", pdrTarget);
+     cmd.AddValue("gwSearch", "Gateway counts (min:max) searched for the smallest layout meeting searchPdr", gwSearch);
+     cmd.AddValue("gwSearchGallop", "Whether to gallop from the lower end of --gwSearch instead of bisecting", gwSearchGallop);
+     cmd.AddValue("searchPdr", "PDR (%) that both IMR and PCC must reach in --gwSearch", searchPdr);
+     cmd.AddValue("gwRangeMargin", "Shadowing margin (dB) of the ISFA gateway range cutoff (negative: every gateway)", gwRangeMargin);
+     cmd.AddValue("kmeansGateways", "Whether to place the gateways on the k-means centroids of the SM positions", kmeansGateways);
+     cmd.AddValue("writeGwLayouts", "Write the 1..k k-means gateway layouts of the SM set to coordsDir and exit", writeGwLayouts);
+     cmd.AddValue("overwriteGwLayouts", "Whether --writeGwLayouts may replace existing <k>gws.csv files", overwriteGwLayouts);
+     cmd.AddValue("streamMinutes", "Streaming mode: write interval rows and retire old uplinks every streamMinutes (simulated), 0 to disable", streamMinutes);
+     cmd.AddValue("pccPriority", "Whether PCC uplinks take over IMR receptions at gateways with no free path and jump the queued IMR packets on the gateway links", pccPriority);
+     cmd.AddValue("selfTest", "Run the self-checks of the support modules and exit", selfTest);
+     cmd.AddValue("profile", "Whether to write the callback costs and the per-hour event rate and queue depth (profile tables)", profile);
+     cmd.AddValue("jobs", "Worker processes of the sweep (0: one per core)", jobs);
+ 
+     cmd.Parse(argc, argv);
+ 
+     if (!ParsePolicies())
+     {
+       return 1;
+     }
+ 
+     if (streamMinutes > 0 && bucketMinutes > 0)
+     {
+       std::cerr << "--streamMinutes replaces --bucketMinutes, whose buckets span the whole run" << std::endl;
+       return 1;
+     }
+ 
+     if (!LoraTables::IsValidPayload(payloadSize))
+     {
+       std::cerr << "Invalid --payload=" << payloadSize << ", expected 0 .. "
+                 << LoraTables::MAX_PHY_PAYLOAD - LoraTables::HEADER_BYTES << std::endl;
+       return 1;
+     }
+ 
+     if (variants != "")
+     {
+       std::string error;
+       if (!ParseVariants(variants, {"txMode", "adr"}, warmupVariants, error))
+       {
+         std::cerr << "Invalid --variants: " << error << std::endl;
+         return 1;
+       }
+       if (!CheckVariants())
+       {
+         return 1;
+       }
+       if (warmupHours <= 0 || sweep != "" || outcomeTrace)
+       {
+         std::cerr << "--variants needs --warmupHours > 0, without --sweep or --outcomeTrace" << std::endl;
+         return 1;
+       }
+     }
+ 
+     if (selfTest)
+     {
+       return RunSelfTests() > 0 ? 1 : 0;
+     }
+ 
+     if (writeGwLayouts > 0)
+     {
+       return WriteGatewayLayouts(writeGwLayouts);
+     }
+ 
+     if (buildCoordBundle != "")
+     {
+       std::string error;
+       if (!BuildCoordBundle(coordsDir, buildCoordBundle, error))
+       {
+         std::cerr << "Cannot build the coordinate bundle: " << error << std::endl;
+         return 1;
+       }
+       return 0;
+     }
+ 
+     if (coordBundle != "")
+     {
+       std::string error;
+       if (!coords.Open(coordBundle, error))
+       {
+         std::cerr << "Invalid --coordBundle: " << error << std::endl;
+         return 1;
+       }
+       // Sweeps and searches check their own cells
+       bool singleCell = sweep == "" && gwSearch == "" && !kmeansGateways;
+       if (singleCell && !HasCoordSets(density > 0 ? density : nDevices,
+                                       gwCount > 0 ? gwCount : nGateways))
+       {
+         return 1;
+       }
+     }
+ 
+     if (sweep != "")
+     {
+       return RunSweep();
+     }
+ 
+     int firstRun = nRun;
+     int lastRun = nRun;
+     if (runs != "" && !ParseRuns(runs, firstRun, lastRun))
+     {
+       std::cerr << "Invalid --runs=" << runs << ", expected first:last" << std::endl;
+       return 1;
+     }
+ 
+     if (gwSearch != "")
+     {
+       return RunGatewaySearch(firstRun, lastRun);
+     }
+ 
+     RunReplications(firstRun, lastRun);
  
      return 0;
  }
- 
\ No newline at end of file
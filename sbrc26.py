@@ -1,5 +1,7 @@
+import json
 import os
 import threading
+import numpy as np
 import pandas as pd
 from concurrent.futures import ProcessPoolExecutor
 import time
@@ -15,7 +17,9 @@ def run_simulation(ns3_cmd, script, params01, params02, params3, j):
     print(f"[{timestamp_start}] [INFO] Iniciando execução: run {j}")
 
     start_time = time.time()
-    run_cmd = f'{ns3_cmd} run "{script} {params01} {params02} {params3} --nRun={j}"'
+    # j is either one seed or a "first:last" range run back to back by sbrc26.cc
+    run_arg = f'--runs={j}' if isinstance(j, str) else f'--nRun={j}'
+    run_cmd = f'{ns3_cmd} run "{script} {params01} {params02} {params3} {run_arg}"'
     exit_code = os.system(run_cmd)
     end_time = time.time()
 
@@ -26,7 +30,8 @@ def run_simulation(ns3_cmd, script, params01, params02, params3, j):
     return duration
 
 def simulate(script, path, sm_coords, gw_coords, radius, sfa, ns3_cmd,
-             adr_enabled=0, adr_type="ns3::AdrComponent", adr_name="adr"):
+             adr_enabled=0, adr_type="ns3::AdrComponent", adr_name="adr", in_process=False,
+             coord_bundle=None):
     init_iters = [1]
     end_iters = [2]
 
@@ -37,15 +42,20 @@ def simulate(script, path, sm_coords, gw_coords, radius, sfa, ns3_cmd,
     max_procs = os.cpu_count()
     print(f"[INFO] Detectado {max_procs} núcleos. É possível executar até {max_procs} simulações em paralelo.")
 
-    # Salvar arquivos CSV
-    sm_file = make_file_name(path, f'{len(sm_coords)}sm_file')
-    pd.DataFrame(sm_coords).to_csv(sm_file, header=False, index=False)
-    gw_file = make_file_name(path, f'{len(gw_coords)}gw_file')
-    pd.DataFrame(gw_coords).to_csv(gw_file, header=False, index=False)
-
     # Parâmetros fixos
     params01 = f'--nDevices={len(sm_coords)} --nGateways={len(gw_coords)} --path={path}'
-    params02 = f'--smFile={sm_file} --gwFile={gw_file} --radius={radius} --sfa={sfa}'
+
+    if coord_bundle:
+        # The sets are read from the bundle (build_coord_bundle), no CSV copies
+        coords_arg = f'--coordBundle={coord_bundle}'
+    else:
+        # Salvar arquivos CSV
+        sm_file = make_file_name(path, f'{len(sm_coords)}sm_file')
+        pd.DataFrame(sm_coords).to_csv(sm_file, header=False, index=False)
+        gw_file = make_file_name(path, f'{len(gw_coords)}gw_file')
+        pd.DataFrame(gw_coords).to_csv(gw_file, header=False, index=False)
+        coords_arg = f'--smFile={sm_file} --gwFile={gw_file}'
+    params02 = f'{coords_arg} --radius={radius} --sfa={sfa}'
     params03 = f'--adrEnabled={adr_enabled} --adrType={adr_type} --adrName={adr_name}'
 
     # Rodar comando inicial do ns3 (se necessário)
@@ -55,6 +65,12 @@ def simulate(script, path, sm_coords, gw_coords, radius, sfa, ns3_cmd,
     with ProcessPoolExecutor(max_workers=max_procs) as executor:
         futures = []
         for i in range(len(init_iters)):
+            # One process per seed range instead of one process per seed
+            if in_process:
+                futures.append(executor.submit(run_simulation, ns3_cmd, script, params01, params02,
+                                               params03, f'{init_iters[i]}:{end_iters[i] - 1}'))
+                continue
+
             for j in range(init_iters[i], end_iters[i]):
                 futures.append(executor.submit(run_simulation, ns3_cmd, script, 
                                                params01, params02, params03, j))
@@ -95,14 +111,83 @@ def simulate(script, path, sm_coords, gw_coords, radius, sfa, ns3_cmd,
 
   os.system(ns3_cmd)'''
 
+def sweep(spec, path, coords_dir, ns3_cmd, jobs=0, extra=''):
+    """Run a whole sweep from one ns-3 process. Cells are spread over forked
+    workers by sbrc26.cc and the results land in {path}/{sfa}/{N}/."""
+    start_time = time.time()
+    os.system(ns3_cmd)
+    run_cmd = (f'{ns3_cmd} run "{script} --sweep={spec} --path={path} '
+               f'--coordsDir={coords_dir} --jobs={jobs} {extra}"')
+    exit_code = os.system(run_cmd)
+    duration = round(time.time() - start_time, 2)
+    print(f"[INFO] Sweep {spec} | Código: {exit_code} | Duração: {duration}s")
+    return exit_code
+
+def build_coord_bundle(bundle, coords_dir, ns3_cmd):
+    """Pack every <N>/<N>sms.csv and <N>/<k>gws.csv under coords_dir into one
+    binary bundle for --coordBundle."""
+    os.system(ns3_cmd)
+    return os.system(f'{ns3_cmd} run "{script} --coordsDir={coords_dir} --buildCoordBundle={bundle}"')
+
 def make_file_name(path, name, ext='csv'):
    return f'{path}/{name}.{ext}'
 
+# Record layout written by outcome-tracer.h (--outcomeTrace)
+outcome_header = np.dtype([('magic', 'S4'), ('version', '<u4'), ('record_size', '<u4'), ('nRun', '<u4')])
+outcome_record = np.dtype([('uid', '<u8'), ('time_ns', '<i8'), ('gw', '<u4'), ('outcome', 'u1'),
+                           ('sf', 'u1'), ('app', 'u1'), ('pad', 'u1')])
+outcome_names = ['ok', 'expired', 'interf', 'under', 'no_more', 'busy']
+
+def load_outcomes(file):
+   header = np.fromfile(file, dtype=outcome_header, count=1)[0]
+   if header['magic'] != b'SBOT' or header['record_size'] != outcome_record.itemsize:
+      raise ValueError(f'{file} is not an outcome trace')
+
+   df = pd.DataFrame(np.fromfile(file, dtype=outcome_record, offset=outcome_header.itemsize))
+   df['outcome'] = pd.Categorical.from_codes(df['outcome'], outcome_names)
+   return df.drop(columns='pad')
+
+# Table layout written by result-row.h (--resultFormat=bin|both)
+def load_results(file):
+   with open(file, 'rb') as f:
+      buf = f.read()
+   if buf[:4] != b'SBRR':
+      raise ValueError(f'{file} is not a binary result table')
+
+   n_cols = int(np.frombuffer(buf, dtype='<u4', count=1, offset=8)[0])
+   pos, fields = 12, []
+   for _ in range(n_cols):
+      kind, size = buf[pos], buf[pos + 1]
+      fields.append((buf[pos + 2:pos + 2 + size].decode(), '<i8' if kind == 0 else '<f8'))
+      pos += 2 + size
+
+   return pd.DataFrame(np.frombuffer(buf, dtype=np.dtype(fields), offset=pos))
+
+# JSON lines appended by sbrc26.cc with --progressMinutes=<m> --progressFile=<file>
+def tail_progress(file, poll=1.0):
+   """Yield the progress reports of file as they are written, e.g. to predict
+   the end of a cell from eta_s or to kill it when ratio stays too low."""
+   while not os.path.exists(file):
+      time.sleep(poll)
+
+   with open(file) as f:
+      buf = ''
+      while True:
+         chunk = f.readline()
+         if not chunk:
+            time.sleep(poll)
+            continue
+         buf += chunk
+         if buf.endswith('\n'):
+            yield json.loads(buf)
+            buf = ''
+
 def check(file):
    names = [
         'sent', 'rec', 'pdr', 'imr_sent', 'imr_rec', 'imr_pdr', 'an_sent', 'an_rec',
         'an_pdr', 'delay', 'imr_delay', 'pcc_delay', 'rssi', 'snr', 'energy', 'tput',
-        'ee1', 'ee2', 'ee3', 'ee4', 'rssi_pkts', 'snr_pkts', 'nRun'
+        'ee1', 'ee2', 'ee3', 'ee4', 'rssi_pkts', 'snr_pkts',
+        'imr_p50', 'imr_p95', 'imr_p99', 'imr_p999', 'an_p50', 'an_p95', 'an_p99', 'an_p999', 'nRun'
    ]
 
    df = pd.read_csv(file, names=names)
@@ -0,0 +1,68 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "scenario-policy.h"
+
+bool ParseSfaPolicy(const std::string& name, SfaPolicy& policy)
+{
+  static const struct
+  {
+    const char* m_name;
+    SfaPolicy m_policy;
+  } names[] = {
+      {"", SfaPolicy::NONE},
+      {"none", SfaPolicy::NONE},
+      {"isfa", SfaPolicy::ISFA},
+      {"rsfa", SfaPolicy::RSFA},
+      {"sftpa", SfaPolicy::SFTPA},
+      {"drsfa", SfaPolicy::DRSFA},
+      {"drsftpa", SfaPolicy::DRSFTPA},
+      {"asfa", SfaPolicy::ASFA},
+  };
+
+  for (const auto& entry : names)
+  {
+    if (name == entry.m_name)
+    {
+      policy = entry.m_policy;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ParseTxMode(const std::string& name, TxMode& mode)
+{
+  if (name == "nack")
+  {
+    mode = TxMode::NACK;
+    return true;
+  }
+  if (name == "ack")
+  {
+    mode = TxMode::ACK;
+    return true;
+  }
+  return false;
+}
+
+bool ParseAdrFlavor(const std::string& name, AdrFlavor& flavor)
+{
+  if (name == "adr")
+  {
+    flavor = AdrFlavor::ADR;
+    return true;
+  }
+  if (name == "caadr")
+  {
+    flavor = AdrFlavor::CAADR;
+    return true;
+  }
+  if (name == "mbadr")
+  {
+    flavor = AdrFlavor::MBADR;
+    return true;
+  }
+  return false;
+}
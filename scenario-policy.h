@@ -0,0 +1,78 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+/*
+ * Enumerated scenario policies: spreading factor allocation, transmission
+ * mode and ADR flavor.
+ *
+ * The command-line strings are parsed once into these enums. Behaviour
+ * that runs on every trace event is described by SfaTraits and resolved at
+ * compile time: the callbacks are instantiated per policy, so a scheme
+ * without a reactive step carries no branch for it.
+ *
+ * Adding an SFA scheme: add the enum value and its name in
+ * scenario-policy.cc, specialise SfaTraits if it reacts to trace events, and
+ * add its allocation and dispatch cases in sbrc26.cc.
+ */
+
+#ifndef SCENARIO_POLICY_H
+#define SCENARIO_POLICY_H
+
+#include <string>
+
+enum class SfaPolicy
+{
+  NONE,    //!< No allocation, the MAC defaults (or ADR) apply
+  ISFA,    //!< SF from the gateway sensitivity
+  RSFA,
+  SFTPA,
+  DRSFA,
+  DRSFTPA,
+  ASFA     //!< Reactive: one SF up on each interference loss
+};
+
+enum class TxMode
+{
+  NACK,
+  ACK
+};
+
+enum class AdrFlavor
+{
+  ADR,
+  CAADR,
+  MBADR
+};
+
+/**
+ * Per-event behaviour of an SFA scheme.
+ */
+template <SfaPolicy P>
+struct SfaTraits
+{
+  static constexpr bool REACTIVE = false; //!< Whether interference losses change the SF
+};
+
+template <>
+struct SfaTraits<SfaPolicy::ASFA>
+{
+  static constexpr bool REACTIVE = true;
+};
+
+/**
+ * \return false if name is not a known scheme; "" and "none" mean NONE.
+ */
+bool ParseSfaPolicy(const std::string& name, SfaPolicy& policy);
+
+/**
+ * \return false if name is neither "nack" nor "ack".
+ */
+bool ParseTxMode(const std::string& name, TxMode& mode);
+
+/**
+ * \return false if name is not one of "adr", "caadr" and "mbadr".
+ */
+bool ParseAdrFlavor(const std::string& name, AdrFlavor& flavor);
+
+#endif /* SCENARIO_POLICY_H */
@@ -0,0 +1,268 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "self-test.h"
+
+#include "gateway-search.h"
+#include "kmeans.h"
+#include "packet-ledger.h"
+
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+
+static uint32_t g_nChecks = 0;
+static uint32_t g_nFailed = 0;
+
+static void
+Check(bool ok, const std::string& what)
+{
+  g_nChecks++;
+  if (!ok)
+  {
+    g_nFailed++;
+    std::cerr << "selfTest: FAILED " << what << std::endl;
+  }
+}
+
+/**
+ * Every threshold of every range, with bisection and galloping: the result
+ * is the threshold, 0 when it lies beyond the range, and no count is probed
+ * twice.
+ */
+static void
+TestGatewaySearch()
+{
+  for (uint32_t min = 1; min <= 4; min++)
+  {
+    for (uint32_t max = min; max <= 28; max++)
+    {
+      for (uint32_t threshold = min; threshold <= max + 1; threshold++)
+      {
+        for (bool gallop : {false, true})
+        {
+          std::map<uint32_t, uint32_t> calls;
+          GatewaySearch search(min, max, gallop);
+          uint32_t found = search.Run([&](uint32_t nGateways) {
+            calls[nGateways]++;
+            return nGateways >= threshold;
+          });
+
+          std::ostringstream what;
+          what << "GatewaySearch(" << min << ", " << max << ", " << gallop << ") with threshold "
+               << threshold;
+          Check(found == (threshold <= max ? threshold : 0),
+                what.str() + " returned " + std::to_string(found));
+
+          bool once = true;
+          bool inRange = true;
+          for (const auto& call : calls)
+          {
+            once = once && call.second == 1;
+            inRange = inRange && call.first >= min && call.first <= max;
+          }
+          Check(once && inRange, what.str() + " probed a count twice or out of range");
+          Check(search.GetProbes().size() == calls.size(), what.str() + " lost a probe");
+        }
+      }
+    }
+  }
+
+  // Bisection over 1..28 takes at most 1 + ceil(log2(28)) probes
+  GatewaySearch bisect(1, 28, false);
+  bisect.Run([](uint32_t nGateways) { return nGateways >= 17; });
+  Check(bisect.GetProbes().size() <= 6, "GatewaySearch bisection of 1..28 took more than 6 probes");
+
+  // Galloping finds a threshold next to the lower end in two probes
+  GatewaySearch gallop(1, 28, true);
+  gallop.Run([](uint32_t nGateways) { return nGateways >= 2; });
+  Check(gallop.GetProbes().size() == 2, "GatewaySearch gallop to 2 in 1..28 did not take 2 probes");
+}
+
+/**
+ * \return The sum of squared distances of the points to their closest
+ *         centroid of layout.
+ */
+static double
+Inertia(const std::vector<double>& x, const std::vector<double>& y,
+        const std::vector<double>& layout)
+{
+  double inertia = 0;
+  for (size_t i = 0; i < x.size(); i++)
+  {
+    double best = INFINITY;
+    for (size_t c = 0; c < layout.size(); c += 2)
+    {
+      double dx = x[i] - layout[c];
+      double dy = y[i] - layout[c + 1];
+      best = std::fmin(best, dx * dx + dy * dy);
+    }
+    inertia += best;
+  }
+  return inertia;
+}
+
+/**
+ * Small layouts with a known answer, k up to and beyond the number of
+ * points, empty clusters, and thread-count independence.
+ */
+static void
+TestKMeans()
+{
+  // k = 1: the centroid is the mean
+  KMeans single(42, 1);
+  single.SetPoints({0, 2, 4, 6}, {1, 1, 3, 3});
+  const std::vector<double>& mean = single.GetLayout(1);
+  Check(std::fabs(mean[0] - 3) < 1e-9 && std::fabs(mean[1] - 2) < 1e-9,
+        "KMeans k = 1 is not the mean of the points");
+  Check(std::fabs(single.GetInertia(1) - 24) < 1e-9, "KMeans k = 1 inertia is not 24");
+
+  // Two far apart clusters
+  std::vector<double> x;
+  std::vector<double> y;
+  for (int i = 0; i < 50; i++)
+  {
+    x.push_back(i % 5);
+    y.push_back(i / 5);
+    x.push_back(1000 + i % 5);
+    y.push_back(i / 5);
+  }
+  KMeans two(42, 1);
+  two.SetPoints(x, y);
+  std::vector<double> layout = two.GetLayout(2);
+  double left = std::fmin(layout[0], layout[2]);
+  double right = std::fmax(layout[0], layout[2]);
+  Check(std::fabs(left - 2) < 1e-9 && std::fabs(right - 1002) < 1e-9
+            && std::fabs(layout[1] - 4.5) < 1e-9 && std::fabs(layout[3] - 4.5) < 1e-9,
+        "KMeans k = 2 did not find the two clusters");
+  Check(std::fabs(two.GetInertia(2) - Inertia(x, y, layout)) < 1e-6,
+        "KMeans inertia is not the one of the final layout");
+
+  // k = number of points, then more centroids than points: the extra
+  // clusters stay empty, every centroid is finite and the inertia is 0
+  std::vector<double> px = {0, 10, 20, 30, 40};
+  std::vector<double> py = {0, 5, 0, 5, 0};
+  KMeans all(42, 1);
+  all.SetPoints(px, py);
+  for (uint32_t k = 5; k <= 7; k++)
+  {
+    const std::vector<double>& l = all.GetLayout(k);
+    bool finite = l.size() == 2 * k;
+    for (double v : l)
+    {
+      finite = finite && std::isfinite(v);
+    }
+    Check(finite, "KMeans k = " + std::to_string(k) + " over 5 points has a bad centroid");
+    Check(all.GetInertia(k) < 1e-9, "KMeans k = " + std::to_string(k) + " over 5 points has inertia");
+  }
+
+  // Identical points: every cluster but one is empty
+  KMeans same(42, 1);
+  same.SetPoints(std::vector<double>(10, 7), std::vector<double>(10, 3));
+  const std::vector<double>& l = same.GetLayout(3);
+  Check(l[0] == 7 && l[1] == 3 && l[4] == 7 && l[5] == 3 && same.GetInertia(3) == 0,
+        "KMeans over identical points did not stay on them");
+
+  // Enough points for the thread pool: the layouts are bit-identical
+  std::vector<double> bx;
+  std::vector<double> by;
+  for (uint32_t i = 0; i < 3000; i++)
+  {
+    bx.push_back((i * 7919) % 1009);
+    by.push_back((i * 104729) % 997);
+  }
+  KMeans serial(42, 1);
+  KMeans threaded(42, 4);
+  serial.SetPoints(bx, by);
+  threaded.SetPoints(bx, by);
+  Check(serial.GetLayout(8) == threaded.GetLayout(8)
+            && serial.GetInertia(8) == threaded.GetInertia(8),
+        "KMeans layouts depend on the number of threads");
+
+  // The same points keep their layouts, new points start over
+  std::vector<double> kept = serial.GetLayout(8);
+  serial.SetPoints(bx, by);
+  Check(serial.GetLayout(8) == kept, "KMeans SetPoints with the same points changed the layout");
+  serial.SetPoints(px, py);
+  Check(serial.GetLayout(1).size() == 2 && std::fabs(serial.GetLayout(1)[0] - 20) < 1e-9,
+        "KMeans SetPoints with new points kept the old layouts");
+}
+
+/**
+ * Retire a prefix of a ledger with gaps in its UIDs: the retired UIDs are
+ * forgotten, the others keep their fields under ids shifted down, the
+ * prefix stops at the first packet with an open window, and the ledger
+ * keeps accepting packets.
+ */
+static void
+TestPacketLedger()
+{
+  PacketLedger ledger;
+  const uint64_t uids[] = {100, 102, 103, 107, 108};
+  for (uint32_t i = 0; i < 5; i++)
+  {
+    ledger.Insert(uids[i], (int) i, 10.0 * i, 0, 7);
+  }
+  ledger.m_window[2] = 0;
+
+  Check(ledger.Retire(0) == 0 && ledger.GetN() == 5,
+        "PacketLedger retired a packet sent at the limit");
+  Check(ledger.Retire(25) == 2 && ledger.GetN() == 3,
+        "PacketLedger did not retire the two packets before the open window");
+  Check(ledger.Find(100) == PacketLedger::NONE && ledger.Find(102) == PacketLedger::NONE,
+        "PacketLedger still finds a retired UID");
+  Check(ledger.Find(103) == 0 && ledger.Find(107) == 1 && ledger.Find(108) == 2,
+        "PacketLedger ids did not shift down by the retired count");
+  Check(ledger.Find(104) == PacketLedger::NONE && ledger.Find(101) == PacketLedger::NONE,
+        "PacketLedger finds a UID it never had");
+  Check(ledger.m_edId[0] == 2 && ledger.m_txTime[2] == 40 && ledger.m_uid[1] == 107,
+        "PacketLedger fields did not move with their ids");
+  Check(ledger.Retire(1000) == 0, "PacketLedger retired past an open window");
+
+  uint32_t id = ledger.Insert(111, 5, 50, 1, 8);
+  Check(id == 3 && ledger.Find(111) == 3 && ledger.Find(108) == 2,
+        "PacketLedger Insert after Retire gave a wrong id");
+
+  ledger.m_window[0] = PacketLedger::NONE;
+  Check(ledger.Retire(1000) == 4 && ledger.GetN() == 0 && ledger.Find(111) == PacketLedger::NONE,
+        "PacketLedger did not retire every packet");
+  Check(ledger.Insert(200, 0, 60, 0, 7) == 0 && ledger.Find(200) == 0,
+        "PacketLedger did not restart after retiring every packet");
+
+  // A packet created first may be sent last when its device waits out the
+  // duty cycle, so UIDs come out of transmission order
+  PacketLedger late;
+  late.Insert(50, 0, 0, 0, 7);
+  late.Insert(101, 1, 100, 0, 7);
+  late.Insert(100, 2, 200, 0, 7);
+  Check(late.Retire(50) == 1 && late.GetN() == 2,
+        "PacketLedger did not retire the first packet sent");
+  Check(late.Find(50) == PacketLedger::NONE && late.Find(101) == 0 && late.Find(100) == 1,
+        "PacketLedger lost a live UID below the oldest remaining one");
+  id = late.Insert(60, 3, 300, 0, 7);
+  Check(id == 2 && late.Find(60) == 2 && late.Find(100) == 1,
+        "PacketLedger dropped a late packet with a UID below the remaining ones");
+  Check(late.Retire(1000) == 3 && late.GetN() == 0 && late.Find(60) == PacketLedger::NONE,
+        "PacketLedger did not retire every out of order packet");
+  id = late.Insert(55, 4, 400, 0, 7);
+  Check(id == 0 && late.Find(55) == 0,
+        "PacketLedger dropped a late packet after retiring every packet");
+}
+
+uint32_t
+RunSelfTests()
+{
+  g_nChecks = 0;
+  g_nFailed = 0;
+
+  TestGatewaySearch();
+  TestKMeans();
+  TestPacketLedger();
+
+  std::cout << "selfTest: " << g_nChecks - g_nFailed << "/" << g_nChecks << " checks passed"
+            << std::endl;
+  return g_nFailed;
+}
@@ -0,0 +1,25 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+/*
+ * Self-checks of the support modules that do not need a simulation.
+ *
+ * The modules are compiled into the scenario executable, so their checks
+ * run from it as well, with --selfTest, instead of from a separate test
+ * binary. Each check prints what it expected on failure.
+ */
+
+#ifndef SELF_TEST_H
+#define SELF_TEST_H
+
+#include <cstdint>
+
+/**
+ * Run every self-check.
+ *
+ * \return The number of failed checks.
+ */
+uint32_t RunSelfTests();
+
+#endif /* SELF_TEST_H */
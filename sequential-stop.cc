@@ -0,0 +1,77 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "sequential-stop.h"
+
+#include <cmath>
+#include <limits>
+
+// t(0.975, df) for df = 1 .. 30, the normal quantile beyond
+static const double T_975[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306,
+                               2.262,  2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120,
+                               2.110,  2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064,
+                               2.060,  2.056, 2.052, 2.048, 2.045, 2.042};
+
+double RunningStat::GetHalfWidth() const
+{
+  if (m_n < 2)
+  {
+    return std::numeric_limits<double>::infinity();
+  }
+
+  uint32_t df = m_n - 1;
+  double t = df <= 30 ? T_975[df - 1] : 1.960;
+  return t * std::sqrt(GetVariance() / m_n);
+}
+
+SequentialStop::SequentialStop(const std::vector<std::string>& names, double relHalfWidth,
+                               uint32_t minRuns)
+    : m_names(names),
+      m_stats(names.size()),
+      m_relHalfWidth(relHalfWidth),
+      m_minRuns(minRuns < 2 ? 2 : minRuns)
+{
+}
+
+void SequentialStop::Add(const std::vector<double>& values)
+{
+  for (size_t i = 0; i < m_stats.size() && i < values.size(); i++)
+  {
+    m_stats[i].Add(values[i]);
+  }
+}
+
+bool SequentialStop::IsConverged() const
+{
+  for (const RunningStat& stat : m_stats)
+  {
+    if (stat.GetN() < m_minRuns)
+    {
+      return false;
+    }
+    if (stat.GetHalfWidth() > m_relHalfWidth * std::fabs(stat.GetMean()))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+void WilsonInterval(uint64_t successes, uint64_t trials, double z, double& lower, double& upper)
+{
+  if (trials == 0)
+  {
+    lower = 0;
+    upper = 1;
+    return;
+  }
+
+  double n = (double) trials;
+  double p = successes / n;
+  double z2 = z * z;
+  double center = (p + z2 / (2 * n)) / (1 + z2 / n);
+  double margin = z * std::sqrt(p * (1 - p) / n + z2 / (4 * n * n)) / (1 + z2 / n);
+  lower = std::fmax(0.0, center - margin);
+  upper = std::fmin(1.0, center + margin);
+}
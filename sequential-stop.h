@@ -0,0 +1,113 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+/*
+ * Sequential stopping of replications and of a single run.
+ *
+ * SequentialStop keeps the running mean and variance (Welford) of a few
+ * metrics across the replications of a cell and tells the multi-run driver
+ * to stop once the Student t confidence interval of every metric is
+ * narrower than a target fraction of its mean. WilsonInterval bounds a
+ * proportion such as the PDR of the uplinks closed so far, so a run can end
+ * as soon as a PDR target is clearly met or clearly missed.
+ */
+
+#ifndef SEQUENTIAL_STOP_H
+#define SEQUENTIAL_STOP_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class RunningStat
+{
+public:
+  void Add(double value)
+  {
+    m_n++;
+    double delta = value - m_mean;
+    m_mean += delta / m_n;
+    m_m2 += delta * (value - m_mean);
+  }
+
+  uint32_t GetN() const
+  {
+    return m_n;
+  }
+
+  double GetMean() const
+  {
+    return m_mean;
+  }
+
+  double GetVariance() const
+  {
+    return m_n > 1 ? m_m2 / (m_n - 1) : 0.0;
+  }
+
+  /**
+   * \return The half-width of the 95% Student t confidence interval of the
+   *         mean, infinite with fewer than two values.
+   */
+  double GetHalfWidth() const;
+
+private:
+  uint32_t m_n = 0;
+  double m_mean = 0;
+  double m_m2 = 0;
+};
+
+class SequentialStop
+{
+public:
+  /**
+   * \param names Metrics tracked, in the order of the values given to Add.
+   * \param relHalfWidth Target half-width, as a fraction of the mean.
+   * \param minRuns Replications always run before stopping.
+   */
+  SequentialStop(const std::vector<std::string>& names, double relHalfWidth, uint32_t minRuns);
+
+  void Add(const std::vector<double>& values);
+
+  /**
+   * \return true once every metric is within its target after at least
+   *         minRuns replications. A metric with a zero mean is within its
+   *         target when its half-width is zero too.
+   */
+  bool IsConverged() const;
+
+  uint32_t GetNMetrics() const
+  {
+    return (uint32_t) m_stats.size();
+  }
+
+  const std::string& GetName(uint32_t metric) const
+  {
+    return m_names[metric];
+  }
+
+  const RunningStat& Get(uint32_t metric) const
+  {
+    return m_stats[metric];
+  }
+
+private:
+  std::vector<std::string> m_names;
+  std::vector<RunningStat> m_stats;
+  double m_relHalfWidth;
+  uint32_t m_minRuns;
+};
+
+/**
+ * Wilson score interval of a proportion.
+ *
+ * \param successes Number of successes.
+ * \param trials Number of trials.
+ * \param z Normal quantile of the confidence level, e.g. 2.576 for 99%.
+ * \param lower Lower bound, in [0, 1].
+ * \param upper Upper bound, in [0, 1].
+ */
+void WilsonInterval(uint64_t successes, uint64_t trials, double z, double& lower, double& upper);
+
+#endif /* SEQUENTIAL_STOP_H */
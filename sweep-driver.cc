@@ -0,0 +1,478 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "sweep-driver.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <thread>
+
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Messages from a worker to the parent
+enum SweepMsg : uint8_t
+{
+  SWEEP_ROW,     //!< A result row: file name, header and content follow
+  SWEEP_METRICS, //!< The stop rule metrics of the current cell follow
+  SWEEP_DONE     //!< The current cell is finished
+};
+
+static const int32_t SWEEP_EXIT = -1; //!< Cell index telling a worker to exit
+
+static int g_resultFd = -1; //!< Write end of the result pipe inside a worker
+
+static bool
+WriteAll(int fd, const void* data, size_t size)
+{
+  const char* p = static_cast<const char*>(data);
+  while (size > 0)
+  {
+    ssize_t n = write(fd, p, size);
+    if (n < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (n <= 0)
+    {
+      return false;
+    }
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+static bool
+ReadAll(int fd, void* data, size_t size)
+{
+  char* p = static_cast<char*>(data);
+  while (size > 0)
+  {
+    ssize_t n = read(fd, p, size);
+    if (n < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (n <= 0)
+    {
+      return false;
+    }
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+static bool
+WriteString(int fd, const std::string& str)
+{
+  uint32_t len = (uint32_t) str.size();
+  return WriteAll(fd, &len, sizeof(len)) && WriteAll(fd, str.data(), len);
+}
+
+static bool
+ReadString(int fd, std::string& str)
+{
+  uint32_t len;
+  if (!ReadAll(fd, &len, sizeof(len)))
+  {
+    return false;
+  }
+  str.resize(len);
+  return ReadAll(fd, &str[0], len);
+}
+
+/**
+ * Parse "a,b,c:d" into its integer values.
+ */
+static bool
+ParseIntList(const std::string& list, std::vector<int>& values)
+{
+  std::istringstream iss(list);
+  std::string item;
+  while (std::getline(iss, item, ','))
+  {
+    size_t sep = item.find(':');
+    try
+    {
+      int first = std::stoi(item.substr(0, sep));
+      int last = (sep == std::string::npos ? first : std::stoi(item.substr(sep + 1)));
+      for (int v = first; v <= last; v++)
+      {
+        values.push_back(v);
+      }
+    }
+    catch (const std::exception&)
+    {
+      return false;
+    }
+  }
+  return !values.empty();
+}
+
+bool
+ParseSweepSpec(const std::string& spec, std::vector<SweepCell>& cells, std::string& error)
+{
+  std::map<std::string, std::string> dims;
+  std::istringstream iss(spec);
+  std::string field;
+  while (std::getline(iss, field, ';'))
+  {
+    size_t eq = field.find('=');
+    if (eq == std::string::npos)
+    {
+      error = "missing '=' in \"" + field + "\"";
+      return false;
+    }
+    dims[field.substr(0, eq)] = field.substr(eq + 1);
+  }
+
+  std::vector<int> devices;
+  std::vector<int> gateways;
+  std::vector<int> seeds;
+  std::vector<std::string> sfas;
+
+  if (!ParseIntList(dims["devices"], devices))
+  {
+    error = "invalid or missing devices";
+    return false;
+  }
+  if (!ParseIntList(dims["gateways"], gateways))
+  {
+    error = "invalid or missing gateways";
+    return false;
+  }
+  if (!ParseIntList(dims.count("runs") ? dims["runs"] : "1", seeds))
+  {
+    error = "invalid runs";
+    return false;
+  }
+
+  std::istringstream sfaList(dims.count("sfa") ? dims["sfa"] : "");
+  std::string sfa;
+  while (std::getline(sfaList, sfa, ','))
+  {
+    sfas.push_back(sfa);
+  }
+  if (sfas.empty())
+  {
+    sfas.push_back("");
+  }
+
+  for (int nDevices : devices)
+  {
+    for (int nGateways : gateways)
+    {
+      for (const std::string& s : sfas)
+      {
+        for (int nRun : seeds)
+        {
+          cells.push_back({nDevices, nGateways, s, nRun});
+        }
+      }
+    }
+  }
+  return true;
+}
+
+SweepDriver::SweepDriver(uint32_t nWorkers) : m_nWorkers(nWorkers)
+{
+  if (m_nWorkers == 0)
+  {
+    m_nWorkers = std::max(1u, std::thread::hardware_concurrency());
+  }
+}
+
+void
+SweepDriver::SetStopRule(const std::vector<std::string>& names, double relHalfWidth,
+                         uint32_t minRuns, GroupWriter writeGroup)
+{
+  m_stopNames = names;
+  m_stopRelHalfWidth = relHalfWidth;
+  m_stopMinRuns = minRuns;
+  m_writeGroup = writeGroup;
+}
+
+bool
+SweepDriver::IsWorker()
+{
+  return g_resultFd >= 0;
+}
+
+void
+SweepDriver::SendRow(const std::string& fileName, const std::string& header,
+                     const std::string& content)
+{
+  uint8_t msg = SWEEP_ROW;
+  WriteAll(g_resultFd, &msg, sizeof(msg));
+  WriteString(g_resultFd, fileName);
+  WriteString(g_resultFd, header);
+  WriteString(g_resultFd, content);
+}
+
+void
+SweepDriver::SendMetrics(const std::vector<double>& values)
+{
+  uint8_t msg = SWEEP_METRICS;
+  uint32_t n = (uint32_t) values.size();
+  WriteAll(g_resultFd, &msg, sizeof(msg));
+  WriteAll(g_resultFd, &n, sizeof(n));
+  WriteAll(g_resultFd, values.data(), n * sizeof(double));
+}
+
+struct SweepWorker
+{
+  pid_t m_pid;
+  int m_cmdFd;    //!< Parent -> worker: cell indices
+  int m_resultFd; //!< Worker -> parent: rows and completions
+  int32_t m_cell; //!< Cell in progress, SWEEP_EXIT if idle
+};
+
+// Cells that differ only by their run, for the stop rule
+struct SweepGroup
+{
+  int32_t m_first; //!< First cell of the group
+  int32_t m_end;   //!< One past the last cell of the group
+  int32_t m_next;  //!< Next cell whose metrics go into m_stop
+  SequentialStop m_stop;
+  std::map<int32_t, std::vector<double>> m_pending; //!< Metrics arrived ahead of m_next, empty if the cell died
+  bool m_converged;
+
+  /**
+   * Add the metrics of cell, then every pending metric that now follows in
+   * run order, so the point where the group converges does not depend on
+   * the order the workers finish in.
+   */
+  void Add(int32_t cell, const std::vector<double>& values)
+  {
+    m_pending[cell] = values;
+    while (!m_converged && m_pending.count(m_next))
+    {
+      if (!m_pending[m_next].empty())
+      {
+        m_stop.Add(m_pending[m_next]);
+        m_converged = m_stop.IsConverged();
+      }
+      m_pending.erase(m_next++);
+    }
+  }
+};
+
+uint32_t
+SweepDriver::Run(const std::vector<SweepCell>& cells, CellRunner runCell, RowWriter writeRow)
+{
+  uint32_t nWorkers = std::min<uint32_t>(m_nWorkers, (uint32_t) cells.size());
+  std::vector<SweepWorker> workers;
+
+  // A dead worker must not take the parent down with it
+  signal(SIGPIPE, SIG_IGN);
+
+  std::cout.flush();
+  for (uint32_t w = 0; w < nWorkers; w++)
+  {
+    int cmdPipe[2];
+    int resultPipe[2];
+    if (pipe(cmdPipe) != 0 || pipe(resultPipe) != 0)
+    {
+      std::cerr << "sweep: pipe failed: " << strerror(errno) << std::endl;
+      break;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+      close(cmdPipe[1]);
+      close(resultPipe[0]);
+      for (const SweepWorker& other : workers)
+      {
+        close(other.m_cmdFd);
+        close(other.m_resultFd);
+      }
+      g_resultFd = resultPipe[1];
+
+      int32_t cell;
+      while (ReadAll(cmdPipe[0], &cell, sizeof(cell)) && cell != SWEEP_EXIT)
+      {
+        runCell(cells[cell]);
+        std::cout.flush();
+
+        uint8_t msg = SWEEP_DONE;
+        WriteAll(g_resultFd, &msg, sizeof(msg));
+      }
+      _exit(0);
+    }
+
+    close(cmdPipe[0]);
+    close(resultPipe[1]);
+    if (pid < 0)
+    {
+      std::cerr << "sweep: fork failed: " << strerror(errno) << std::endl;
+      close(cmdPipe[1]);
+      close(resultPipe[0]);
+      break;
+    }
+    workers.push_back({pid, cmdPipe[1], resultPipe[0], SWEEP_EXIT});
+  }
+
+  // With the stop rule, hand out the first run of every group, then the
+  // second one, and so on, so that a group has as many results as possible
+  // before its later runs are dispatched
+  bool useStop = !m_stopNames.empty();
+  std::vector<SweepGroup> groups;
+  std::vector<uint32_t> cellGroup(cells.size());
+  std::vector<int32_t> order;
+  for (int32_t c = 0; c < (int32_t) cells.size(); c++)
+  {
+    const SweepCell& cell = cells[c];
+    if (!useStop)
+    {
+      order.push_back(c);
+      continue;
+    }
+    if (groups.empty() || cell.m_nDevices != cells[c - 1].m_nDevices
+        || cell.m_nGateways != cells[c - 1].m_nGateways || cell.m_sfa != cells[c - 1].m_sfa)
+    {
+      groups.push_back({c, c, c, SequentialStop(m_stopNames, m_stopRelHalfWidth, m_stopMinRuns), {}, false});
+    }
+    groups.back().m_end = c + 1;
+    cellGroup[c] = (uint32_t) groups.size() - 1;
+  }
+  for (int32_t pos = 0; useStop && order.size() < cells.size(); pos++)
+  {
+    for (const SweepGroup& group : groups)
+    {
+      if (group.m_first + pos < group.m_end)
+      {
+        order.push_back(group.m_first + pos);
+      }
+    }
+  }
+
+  m_nSkipped = 0;
+  size_t nextOrder = 0;
+  auto nextCell = [&]() {
+    while (nextOrder < order.size() && useStop && groups[cellGroup[order[nextOrder]]].m_converged)
+    {
+      nextOrder++;
+      m_nSkipped++;
+    }
+    return nextOrder < order.size() ? order[nextOrder++] : SWEEP_EXIT;
+  };
+
+  // Hand the first cell to every worker, then one more each time a worker
+  // reports completion
+  uint32_t nCompleted = 0;
+  uint32_t nActive = 0;
+  for (SweepWorker& worker : workers)
+  {
+    worker.m_cell = nextCell();
+    WriteAll(worker.m_cmdFd, &worker.m_cell, sizeof(worker.m_cell));
+    nActive++;
+  }
+
+  std::vector<pollfd> fds(workers.size());
+  while (nActive > 0)
+  {
+    for (size_t w = 0; w < workers.size(); w++)
+    {
+      fds[w].fd = workers[w].m_resultFd;
+      fds[w].events = POLLIN;
+      fds[w].revents = 0;
+    }
+
+    if (poll(fds.data(), fds.size(), -1) < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      break;
+    }
+
+    for (size_t w = 0; w < workers.size(); w++)
+    {
+      SweepWorker& worker = workers[w];
+      if (worker.m_resultFd < 0 || !(fds[w].revents & (POLLIN | POLLHUP | POLLERR)))
+      {
+        continue;
+      }
+
+      uint8_t msg;
+      std::string fileName;
+      std::string header;
+      std::string content;
+      bool ok = ReadAll(worker.m_resultFd, &msg, sizeof(msg));
+      if (ok && msg == SWEEP_ROW)
+      {
+        ok = ReadString(worker.m_resultFd, fileName) && ReadString(worker.m_resultFd, header)
+             && ReadString(worker.m_resultFd, content);
+        if (ok)
+        {
+          writeRow(fileName, header, content);
+          continue;
+        }
+      }
+
+      if (ok && msg == SWEEP_METRICS)
+      {
+        uint32_t n;
+        std::vector<double> values;
+        ok = ReadAll(worker.m_resultFd, &n, sizeof(n));
+        if (ok)
+        {
+          values.resize(n);
+          ok = ReadAll(worker.m_resultFd, values.data(), n * sizeof(double));
+        }
+        if (ok)
+        {
+          if (useStop && worker.m_cell != SWEEP_EXIT)
+          {
+            groups[cellGroup[worker.m_cell]].Add(worker.m_cell, values);
+          }
+          continue;
+        }
+      }
+
+      if (ok && msg == SWEEP_DONE)
+      {
+        nCompleted++;
+        worker.m_cell = nextCell();
+        if (WriteAll(worker.m_cmdFd, &worker.m_cell, sizeof(worker.m_cell))
+            && worker.m_cell != SWEEP_EXIT)
+        {
+          continue;
+        }
+      }
+      else if (worker.m_cell != SWEEP_EXIT)
+      {
+        std::cerr << "sweep: worker " << worker.m_pid << " died running cell "
+                  << worker.m_cell << std::endl;
+        if (useStop)
+        {
+          groups[cellGroup[worker.m_cell]].Add(worker.m_cell, {});
+        }
+      }
+
+      close(worker.m_cmdFd);
+      close(worker.m_resultFd);
+      worker.m_resultFd = -1;
+      waitpid(worker.m_pid, nullptr, 0);
+      nActive--;
+    }
+  }
+
+  for (const SweepGroup& group : groups)
+  {
+    m_writeGroup(cells[group.m_first], group.m_stop, group.m_converged);
+  }
+
+  return (uint32_t) cells.size() - nCompleted - m_nSkipped;
+}
@@ -0,0 +1,126 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+/*
+ * Parallel sweep over independent scenario cells.
+ *
+ * The driver forks a pool of worker processes before any simulation object
+ * exists. Workers ask the parent for the next cell whenever they finish one,
+ * so expensive cells (SF12-heavy, 1000 devices) do not leave the other
+ * cores idle the way a static partition would. Every result row produced by
+ * a worker travels back through a pipe and is written by the parent alone,
+ * so no two processes ever append to the same result file.
+ *
+ * With a stop rule, the cells that differ only by their run form a group.
+ * Workers report the metrics of each cell, the parent adds them to the
+ * SequentialStop of its group in run order and stops dispatching the
+ * remaining runs of a group once it converged. Runs already handed out when
+ * that happens still complete and write their rows.
+ */
+
+#ifndef SWEEP_DRIVER_H
+#define SWEEP_DRIVER_H
+
+#include "sequential-stop.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct SweepCell
+{
+  int m_nDevices;
+  int m_nGateways;
+  std::string m_sfa;
+  int m_nRun;
+};
+
+/**
+ * Parse a sweep spec such as
+ * "devices=200,400;gateways=1:28;sfa=isfa,rsfa;runs=1:10" into the cross
+ * product of its dimensions. Each value list takes comma separated items and
+ * inclusive "first:last" integer ranges.
+ *
+ * \param spec The sweep spec.
+ * \param cells The parsed cells.
+ * \return false, with an explanation in error, if the spec is malformed.
+ */
+bool ParseSweepSpec(const std::string& spec, std::vector<SweepCell>& cells, std::string& error);
+
+class SweepDriver
+{
+public:
+  typedef std::function<void(const SweepCell&)> CellRunner;
+  typedef std::function<void(const std::string&, const std::string&, const std::string&)>
+      RowWriter;
+  typedef std::function<void(const SweepCell&, const SequentialStop&, bool)> GroupWriter;
+
+  /**
+   * \param nWorkers Number of worker processes, 0 for one per core.
+   */
+  explicit SweepDriver(uint32_t nWorkers);
+
+  /**
+   * Stop each group of cells once the metrics its workers send with
+   * SendMetrics converge, see SequentialStop.
+   *
+   * \param names Metrics, in the order of the values given to SendMetrics.
+   * \param relHalfWidth Target half-width, as a fraction of the mean.
+   * \param minRuns Runs of a group always dispatched before stopping it.
+   * \param writeGroup Called in the parent, at the end of Run, with the first
+   *        cell of each group, its statistics and whether it converged.
+   */
+  void SetStopRule(const std::vector<std::string>& names, double relHalfWidth, uint32_t minRuns,
+                   GroupWriter writeGroup);
+
+  /**
+   * Run every cell on the worker pool.
+   *
+   * \param cells The cells to run.
+   * \param runCell Called inside a worker for each cell it gets.
+   * \param writeRow Called in the parent with the file name, header and
+   *        content of each row sent with SendRow.
+   * \return The number of cells that did not complete, skipped ones aside.
+   */
+  uint32_t Run(const std::vector<SweepCell>& cells, CellRunner runCell, RowWriter writeRow);
+
+  /**
+   * \return The number of cells the stop rule skipped in the last Run.
+   */
+  uint32_t GetNSkipped() const
+  {
+    return m_nSkipped;
+  }
+
+  /**
+   * \return true inside a worker process.
+   */
+  static bool IsWorker();
+
+  /**
+   * Forward a result row from a worker to the writer of the parent.
+   *
+   * \param fileName Result file.
+   * \param header Header of the file if it is still empty, may be empty.
+   * \param content Rows to append.
+   */
+  static void SendRow(const std::string& fileName, const std::string& header,
+                      const std::string& content);
+
+  /**
+   * Send the metrics of the cell in progress to the stop rule of the parent.
+   */
+  static void SendMetrics(const std::vector<double>& values);
+
+private:
+  uint32_t m_nWorkers;
+  std::vector<std::string> m_stopNames; //!< Metrics of the stop rule, none if it is off
+  double m_stopRelHalfWidth = 0;
+  uint32_t m_stopMinRuns = 0;
+  GroupWriter m_writeGroup;
+  uint32_t m_nSkipped = 0;
+};
+
+#endif /* SWEEP_DRIVER_H */
@@ -0,0 +1,60 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "time-series-metrics.h"
+
+#include <cmath>
+
+TimeSeriesMetrics::TimeSeriesMetrics() : m_nBuckets(0), m_bucketMs(0)
+{
+}
+
+void TimeSeriesMetrics::Setup(double durationMs, double bucketMs)
+{
+  Clear();
+  if (bucketMs <= 0 || durationMs <= 0)
+  {
+    return;
+  }
+
+  m_bucketMs = bucketMs;
+  m_nBuckets = (uint32_t) std::ceil(durationMs / bucketMs);
+  m_cells.assign((size_t) m_nBuckets * N_SF * N_APP, TimeSeriesCell());
+}
+
+TimeSeriesCell TimeSeriesMetrics::Get(uint32_t bucket, uint32_t sfIndex, uint32_t app) const
+{
+  TimeSeriesCell sum;
+  for (uint32_t s = 0; s < N_SF; s++)
+  {
+    if (sfIndex != ALL && s != sfIndex)
+    {
+      continue;
+    }
+
+    for (uint32_t a = 0; a < N_APP; a++)
+    {
+      if (app != ALL && a != app)
+      {
+        continue;
+      }
+
+      const TimeSeriesCell& cell = m_cells[(bucket * N_SF + s) * N_APP + a];
+      sum.m_sent += cell.m_sent;
+      sum.m_rec += cell.m_rec;
+      sum.m_expired += cell.m_expired;
+      sum.m_lost += cell.m_lost;
+      sum.m_sumDelay += cell.m_sumDelay;
+    }
+  }
+  return sum;
+}
+
+void TimeSeriesMetrics::Clear()
+{
+  m_cells.clear();
+  m_cells.shrink_to_fit();
+  m_nBuckets = 0;
+  m_bucketMs = 0;
+}
@@ -0,0 +1,127 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+/*
+ * Per-run time series of the uplink metrics, bucket x SF x application.
+ *
+ * The whole run is split into fixed-width time buckets allocated once when
+ * the run starts. Every counter lives in a flat array indexed by
+ * (bucket, SF 7..12, application), so an event costs one division and one
+ * array increment, and no simulator event is needed to roll the buckets
+ * over: the bucket is derived from the timestamp of the event. Totals over
+ * any dimension are summed on demand when the series is flushed.
+ */
+
+#ifndef TIME_SERIES_METRICS_H
+#define TIME_SERIES_METRICS_H
+
+#include <cstdint>
+#include <vector>
+
+struct TimeSeriesCell
+{
+  uint32_t m_sent = 0;    //!< New uplinks
+  uint32_t m_rec = 0;     //!< Uplinks received within their deadline
+  uint32_t m_expired = 0; //!< Uplinks received after their deadline
+  uint32_t m_lost = 0;    //!< Transmissions lost at every gateway
+  double m_sumDelay = 0;  //!< Sum of the delays of m_rec (ms)
+};
+
+class TimeSeriesMetrics
+{
+public:
+  static const uint32_t N_SF = 6;   //!< SF7 .. SF12
+  static const uint32_t N_APP = 2;  //!< { 0: 'IMR', 1: 'AN' }
+  static const uint32_t ALL = UINT32_MAX; //!< Sum over a dimension in Get
+
+  TimeSeriesMetrics();
+
+  /**
+   * Allocate the buckets of a run, discarding the previous series.
+   *
+   * \param durationMs Length of the run (ms), later events go to the last bucket.
+   * \param bucketMs Width of a bucket (ms).
+   */
+  void Setup(double durationMs, double bucketMs);
+
+  bool IsEnabled() const
+  {
+    return !m_cells.empty();
+  }
+
+  void AddSent(double timeMs, uint8_t sf, uint8_t app)
+  {
+    if (IsEnabled())
+    {
+      Cell(timeMs, sf, app).m_sent++;
+    }
+  }
+
+  void AddRec(double timeMs, uint8_t sf, uint8_t app, double delayMs)
+  {
+    if (IsEnabled())
+    {
+      TimeSeriesCell& cell = Cell(timeMs, sf, app);
+      cell.m_rec++;
+      cell.m_sumDelay += delayMs;
+    }
+  }
+
+  void AddExpired(double timeMs, uint8_t sf, uint8_t app)
+  {
+    if (IsEnabled())
+    {
+      Cell(timeMs, sf, app).m_expired++;
+    }
+  }
+
+  void AddLost(double timeMs, uint8_t sf, uint8_t app)
+  {
+    if (IsEnabled())
+    {
+      Cell(timeMs, sf, app).m_lost++;
+    }
+  }
+
+  uint32_t GetNBuckets() const
+  {
+    return m_nBuckets;
+  }
+
+  double GetBucketMs() const
+  {
+    return m_bucketMs;
+  }
+
+  /**
+   * \param bucket Bucket index.
+   * \param sfIndex SF - 7, or ALL.
+   * \param app Application index, or ALL.
+   * \return The counters of the cell, summed over the ALL dimensions.
+   */
+  TimeSeriesCell Get(uint32_t bucket, uint32_t sfIndex, uint32_t app) const;
+
+  /**
+   * Release the buckets; a cleared series records nothing.
+   */
+  void Clear();
+
+private:
+  TimeSeriesCell& Cell(double timeMs, uint8_t sf, uint8_t app)
+  {
+    uint32_t bucket = timeMs > 0 ? (uint32_t) (timeMs / m_bucketMs) : 0;
+    if (bucket >= m_nBuckets)
+    {
+      bucket = m_nBuckets - 1;
+    }
+    uint32_t sfIndex = (sf >= 7 && sf <= 12) ? sf - 7 : 0;
+    return m_cells[(bucket * N_SF + sfIndex) * N_APP + (app < N_APP ? app : 0)];
+  }
+
+  std::vector<TimeSeriesCell> m_cells;
+  uint32_t m_nBuckets;
+  double m_bucketMs;
+};
+
+#endif /* TIME_SERIES_METRICS_H */
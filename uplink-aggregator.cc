@@ -0,0 +1,126 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "uplink-aggregator.h"
+
+/**
+ * Precedence of the loss causes when the gateways disagree: the cause
+ * reported by the gateway that got closest to a successful reception wins.
+ * An uplink seen by 27 gateways under sensitivity and interfered at the
+ * 28th was lost to interference.
+ */
+static int
+LossRank(PktOutcome outcome)
+{
+  switch (outcome)
+  {
+    case OUTCOME_INTERF:
+      return 4;
+    case OUTCOME_NO_MORE:
+      return 3;
+    case OUTCOME_BUSY:
+      return 2;
+    case OUTCOME_UNDER:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+UplinkAggregator::UplinkAggregator() : m_nGateways(1)
+{
+}
+
+void UplinkAggregator::SetGateways(uint32_t nGateways)
+{
+  m_nGateways = nGateways;
+}
+
+void UplinkAggregator::Reserve(size_t nWindows)
+{
+  m_windows.reserve(nWindows);
+  m_free.reserve(nWindows);
+}
+
+uint32_t UplinkAggregator::Open(uint32_t id)
+{
+  uint32_t window;
+  if (!m_free.empty())
+  {
+    window = m_free.back();
+    m_free.pop_back();
+  }
+  else
+  {
+    window = (uint32_t) m_windows.size();
+    m_windows.emplace_back();
+  }
+
+  UplinkResult& res = m_windows[window];
+  res.m_id = id;
+  res.m_nReports = 0;
+  res.m_success = false;
+  res.m_rxTimeNs = -1;
+  res.m_cause = OUTCOME_UNDER;
+  res.m_bestGwId = UINT32_MAX;
+  res.m_bestRxPower = -1e9;
+  res.m_bestSnr = -1e9;
+  res.m_sf = 0;
+  return window;
+}
+
+bool UplinkAggregator::Add(uint32_t window, uint32_t gwId, PktOutcome outcome, uint8_t sf,
+                           double rxPower, double snr, int64_t timeNs)
+{
+  UplinkResult& res = m_windows[window];
+
+  if (res.m_nReports == 0 || LossRank(outcome) > LossRank(res.m_cause))
+  {
+    res.m_cause = outcome;
+  }
+  res.m_nReports++;
+  res.m_sf = sf;
+
+  if (rxPower > res.m_bestRxPower)
+  {
+    res.m_bestRxPower = rxPower;
+    res.m_bestSnr = snr;
+    res.m_bestGwId = gwId;
+  }
+
+  if (outcome == OUTCOME_OK && !res.m_success)
+  {
+    res.m_success = true;
+    res.m_rxTimeNs = timeNs;
+  }
+
+  return res.m_nReports >= m_nGateways;
+}
+
+UplinkResult UplinkAggregator::Close(uint32_t window)
+{
+  UplinkResult res = m_windows[window];
+  if (res.m_success)
+  {
+    res.m_cause = OUTCOME_OK;
+  }
+
+  m_free.push_back(window);
+  return res;
+}
+
+void UplinkAggregator::Rebase(uint32_t shift)
+{
+  // Released windows are rewritten by Open, so shifting them too is harmless
+  for (UplinkResult& res : m_windows)
+  {
+    res.m_id -= shift;
+  }
+}
+
+void UplinkAggregator::Clear()
+{
+  m_windows.clear();
+  m_free.clear();
+}
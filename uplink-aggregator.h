@@ -0,0 +1,87 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+/*
+ * Uplink-level aggregation of the gateway reception events.
+ *
+ * With several gateways, every gateway PHY fires one trace (received,
+ * interfered, under sensitivity, no more receivers or busy) for the same
+ * physical transmission. The aggregator collects these events in a
+ * fixed-size window slot per transmission and, once every gateway has
+ * reported, consolidates them into one UplinkResult: any-gateway success,
+ * best receive power/SNR and the dominant loss cause. Slots are recycled
+ * through a free list, so the pool only grows up to the number of
+ * transmissions that are on air at the same time.
+ */
+
+#ifndef UPLINK_AGGREGATOR_H
+#define UPLINK_AGGREGATOR_H
+
+#include "outcome-tracer.h"
+
+#include <cstdint>
+#include <vector>
+
+struct UplinkResult
+{
+  uint32_t m_id;        //!< Ledger id of the uplink
+  uint32_t m_nReports;  //!< Number of gateways that reported the transmission
+  bool m_success;       //!< Whether at least one gateway received it
+  int64_t m_rxTimeNs;   //!< Time of the first successful reception (ns)
+  PktOutcome m_cause;   //!< OUTCOME_OK on success, otherwise the dominant loss cause
+  uint32_t m_bestGwId;  //!< Gateway with the highest receive power
+  double m_bestRxPower; //!< Highest receive power among the gateways (dBm)
+  double m_bestSnr;     //!< SNR at m_bestGwId (dB)
+  uint8_t m_sf;         //!< Spreading factor of the transmission
+};
+
+class UplinkAggregator
+{
+public:
+  static const uint32_t NONE = UINT32_MAX; //!< Invalid window handle
+
+  UplinkAggregator();
+
+  /**
+   * \param nGateways Number of gateways expected to report each transmission.
+   */
+  void SetGateways(uint32_t nGateways);
+
+  void Reserve(size_t nWindows);
+
+  /**
+   * Open the window of a new transmission.
+   *
+   * \param id Ledger id of the uplink.
+   * \return The window handle.
+   */
+  uint32_t Open(uint32_t id);
+
+  /**
+   * Add the outcome of one gateway to a window.
+   *
+   * \return true once every gateway has reported and the window can be closed.
+   */
+  bool Add(uint32_t window, uint32_t gwId, PktOutcome outcome, uint8_t sf,
+           double rxPower, double snr, int64_t timeNs);
+
+  /**
+   * Release a window and return its consolidated result.
+   */
+  UplinkResult Close(uint32_t window);
+
+  /**
+   * Lower the ledger id of every window by shift, after PacketLedger::Retire.
+   */
+  void Rebase(uint32_t shift);
+
+  void Clear();
+
+private:
+  std::vector<UplinkResult> m_windows;
+  std::vector<uint32_t> m_free; //!< Handles of the released windows
+  uint32_t m_nGateways;
+};
+
+#endif /* UPLINK_AGGREGATOR_H */
@@ -0,0 +1,115 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "warmup-fork.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+static bool g_continuation = false;   //!< Set in the forked children
+static std::vector<pid_t> g_children; //!< Continuations of the parent
+
+bool ParseVariants(const std::string& spec, const std::vector<std::string>& allowedKeys,
+                   std::vector<WarmupVariant>& variants, std::string& error)
+{
+  std::istringstream iss(spec);
+  std::string field;
+  while (std::getline(iss, field, ';'))
+  {
+    WarmupVariant variant;
+    size_t colon = field.find(':');
+    variant.m_label = field.substr(0, colon);
+    if (variant.m_label.empty() || variant.m_label.find('/') != std::string::npos)
+    {
+      error = "invalid label in \"" + field + "\"";
+      return false;
+    }
+
+    std::istringstream settings(colon == std::string::npos ? "" : field.substr(colon + 1));
+    std::string setting;
+    while (std::getline(settings, setting, ','))
+    {
+      size_t eq = setting.find('=');
+      if (eq == std::string::npos)
+      {
+        error = "missing '=' in \"" + setting + "\"";
+        return false;
+      }
+
+      std::string key = setting.substr(0, eq);
+      if (std::find(allowedKeys.begin(), allowedKeys.end(), key) == allowedKeys.end())
+      {
+        error = "unknown setting " + key;
+        return false;
+      }
+      variant.m_settings.push_back({key, setting.substr(eq + 1)});
+    }
+    variants.push_back(variant);
+  }
+
+  if (variants.empty())
+  {
+    error = "no variant";
+    return false;
+  }
+  return true;
+}
+
+uint32_t WarmupFork::Fork(uint32_t nVariants)
+{
+  std::cout.flush();
+  std::cerr.flush();
+
+  for (uint32_t v = 1; v < nVariants; v++)
+  {
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+      g_continuation = true;
+      g_children.clear();
+      return v;
+    }
+
+    if (pid < 0)
+    {
+      std::cerr << "warmup: fork of variant " << v << " failed: " << strerror(errno) << std::endl;
+      continue;
+    }
+    g_children.push_back(pid);
+  }
+  return 0;
+}
+
+bool WarmupFork::IsContinuation()
+{
+  return g_continuation;
+}
+
+uint32_t WarmupFork::Finish()
+{
+  if (g_continuation)
+  {
+    std::cout.flush();
+    std::cerr.flush();
+    _exit(0);
+  }
+
+  uint32_t failed = 0;
+  for (pid_t pid : g_children)
+  {
+    int status = 0;
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+      failed++;
+    }
+  }
+  g_children.clear();
+  return failed;
+}
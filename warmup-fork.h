@@ -0,0 +1,68 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+/*
+ * Continuation experiments forked from one warmed-up network.
+ *
+ * With ADR the first hours of a run only bring the data rates and powers to
+ * convergence, and every what-if variant would pay for them again. Instead
+ * the run is simulated once up to the end of the warm-up, then the process
+ * forks one child per extra variant: the child is an exact copy of the
+ * simulator, the network server ADR history included, so it only simulates
+ * the measurement window with its own settings. The parent continues with
+ * the first variant and reaps the children at the end of the run.
+ */
+
+#ifndef WARMUP_FORK_H
+#define WARMUP_FORK_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct WarmupVariant
+{
+  std::string m_label; //!< Results go to <path>/<label>
+  std::vector<std::pair<std::string, std::string>> m_settings;
+};
+
+/**
+ * Parse a variant spec such as "base;ack:txMode=ack;noadr:adr=0,txMode=ack":
+ * variants separated by ';', each a label optionally followed by ':' and
+ * comma separated key=value settings. Only the keys in allowedKeys are
+ * accepted.
+ *
+ * \return false, with an explanation in error, if the spec is malformed.
+ */
+bool ParseVariants(const std::string& spec, const std::vector<std::string>& allowedKeys,
+                   std::vector<WarmupVariant>& variants, std::string& error);
+
+class WarmupFork
+{
+public:
+  /**
+   * Fork one child per variant after the first, from inside a simulator
+   * event.
+   *
+   * \return The index of the variant this process continues with, 0 in the
+   *         parent.
+   */
+  static uint32_t Fork(uint32_t nVariants);
+
+  /**
+   * \return true inside a forked continuation.
+   */
+  static bool IsContinuation();
+
+  /**
+   * End of the run: a continuation exits, the parent waits for its
+   * children.
+   *
+   * \return The number of children that did not exit cleanly.
+   */
+  static uint32_t Finish();
+};
+
+#endif /* WARMUP_FORK_H */